@@ -0,0 +1,107 @@
+// Scaler benchmark: times each filter on a synthetic 256x240 frame at 4x output, and the NTSC
+// filter, and reports whether they keep up with 60 frames per second. Build and run with `make bench`; pass a
+// thread count to scale on a worker pool instead of one core.
+#include "ntsc.h"
+#include "palette.h"
+#include "scaler.h"
+#include "worker_pool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const int WIDTH = 256;
+    const int HEIGHT = 240;
+    const int FRAMES = 300;
+
+    // Tile-like test picture: 8x8 blocks of a few colours with diagonal edges inside them
+    std::vector<uint8_t> makeIndices()
+    {
+        std::vector<uint8_t> indices(WIDTH * HEIGHT);
+        for (int y = 0; y < HEIGHT; ++y)
+        {
+            for (int x = 0; x < WIDTH; ++x)
+            {
+                int tile = (x / 8) * 7 + (y / 8) * 13;
+                bool diagonal = (x & 7) > (y & 7);
+                indices[y * WIDTH + x] = static_cast<uint8_t>(diagonal ? (tile & 0x3F) : 0x0F);
+            }
+        }
+        return indices;
+    }
+
+    std::vector<uint32_t> makeFrame(const std::vector<uint8_t> &indices)
+    {
+        std::vector<uint8_t> emphasis(HEIGHT, 0);
+        std::vector<uint32_t> argb(WIDTH * HEIGHT);
+        convertFrame(indices.data(), emphasis.data(), WIDTH, HEIGHT, PixelFormat::ARGB8888,
+                     argb.data(), WIDTH * 4);
+        return argb;
+    }
+
+    void report(const char *name, double msPerFrame)
+    {
+        printf("%-22s %8.3f ms/frame %8.1f fps  %s\n", name, msPerFrame, 1000.0 / msPerFrame,
+               msPerFrame < 1000.0 / 60.0 ? "ok" : "TOO SLOW");
+    }
+
+    // Time one pipeline: the filter, followed by a 2x nearest pass to reach 4x for the 2x filters
+    void run(const char *name, ScaleFilter filter, const std::vector<uint32_t> &frame, WorkerPool *pool)
+    {
+        int factor = scaleFactor(filter, 4);
+        std::vector<uint32_t> scaled(WIDTH * factor * HEIGHT * factor);
+        std::vector<uint32_t> output(WIDTH * 4 * HEIGHT * 4);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; ++i)
+        {
+            scaleFrame(filter, frame.data(), WIDTH * 4, WIDTH, HEIGHT, 4, scaled.data(), WIDTH * factor * 4, pool);
+            if (factor == 2)
+            {
+                scaleNearest(scaled.data(), WIDTH * 2 * 4, WIDTH * 2, HEIGHT * 2, 2,
+                             output.data(), WIDTH * 4 * 4, pool);
+            }
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+        report(name, elapsed.count() / FRAMES);
+    }
+
+    void runNTSC(const std::vector<uint8_t> &indices, WorkerPool *pool)
+    {
+        std::vector<uint8_t> emphasis(HEIGHT, 0);
+        std::vector<uint32_t> output(NTSC_OUTPUT_WIDTH * HEIGHT);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; ++i)
+        {
+            ntscFilterFrame(indices.data(), emphasis.data(), HEIGHT, i % 3, output.data(), NTSC_OUTPUT_WIDTH * 4, pool);
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+        report("ntsc (512x240)", elapsed.count() / FRAMES);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 0;
+    std::unique_ptr<WorkerPool> pool;
+    if (threads > 0)
+        pool.reset(new WorkerPool(threads));
+
+    std::vector<uint8_t> indices = makeIndices();
+    std::vector<uint32_t> frame = makeFrame(indices);
+    printf("%dx%d -> %dx%d, %d frames, %d worker threads\n", WIDTH, HEIGHT, WIDTH * 4, HEIGHT * 4,
+           FRAMES, threads);
+
+    run("nearest 4x", ScaleFilter::Nearest, frame, pool.get());
+    run("scale2x + nearest 2x", ScaleFilter::Scale2x, frame, pool.get());
+    run("scale3x (3x)", ScaleFilter::Scale3x, frame, pool.get());
+    run("hq2x + nearest 2x", ScaleFilter::HQ2x, frame, pool.get());
+    runNTSC(indices, pool.get());
+    return 0;
+}
@@ -0,0 +1,212 @@
+#ifndef APU_H
+#define APU_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include "blip_buffer.h"
+
+class CPU;
+
+// The 2A03 APU: two pulse channels, triangle, noise, DMC and the frame counter.
+//
+// The APU is caught up lazily, like the PPU: a register access first runs the channels up to
+// the CPU's current cycle. Channels are advanced from one timer clock to the next, not cycle
+// by cycle, and whenever the mixed output changes the difference goes into a band-limited
+// step buffer (blip_buffer.h). endFrame() closes the frame and decimates it to the output
+// sample rate. Times are CPU cycles from the start of the frame, as in CPU::cycles.
+//
+// DMC sample fetches are DMA on the CPU bus. The APU schedules each one for the cycle the
+// sample buffer empties; the CPU stops after the instruction that passes nextEventCycle() and
+// calls catchUp(), and every fetch performed charges its stall to the CPU (CPU::stallForDmc).
+// The frame counter and DMC interrupts drive the CPU's IRQ line. The frame interrupt is an
+// event too, so it is raised on the instruction it falls in even if the APU is not accessed.
+class APU
+{
+public:
+    static constexpr double CPU_CLOCK_RATE = 1789773.0; // NTSC 2A03
+    static constexpr int MIX_SCALE = 28000;              // Output units for a mix level of 1.0
+    static constexpr int32_t NO_DMA = std::numeric_limits<int32_t>::max();
+
+    enum class Channel
+    {
+        Pulse1,
+        Pulse2,
+        Triangle,
+        Noise,
+        DMC
+    };
+    static constexpr int CHANNEL_COUNT = 5;
+
+    explicit APU(int sampleRate = 44100);
+    APU(const APU &) = delete;
+    APU &operator=(const APU &) = delete;
+
+    void reset();
+    void setCPU(CPU *cpuInstance); // Timing source and DMC sample bus
+
+    void writeRegister(uint16_t address, uint8_t value); // $4000-$4013, $4015, $4017
+    uint8_t readStatus();                                // $4015
+
+    int32_t nextDmaCycle() const;   // Cycle of the next DMC fetch, or NO_DMA
+    int32_t nextEventCycle() const; // Next DMC fetch or frame interrupt, or NO_DMA
+    void catchUp();                 // Run to the CPU's current cycle
+
+    // Run to the end of a frame of frameCycles CPU cycles and make its samples readable. The
+    // caller then rebases the CPU by the same amount (CPU::endFrame).
+    void endFrame(int32_t frameCycles);
+
+    int samplesAvailable() const { return output.samplesAvailable(); }
+    int readSamples(int16_t *out, int count) { return output.readSamples(out, count); }
+    int getSampleRate() const { return output.getSampleRate(); }
+
+    // Per-channel output. A tap synthesises one channel alone, through the same mixer curve
+    // as the mix, into a band-limited buffer of its own that is read like the mix. Its samples
+    // line up with the mix's when it is enabled before the first frame after reset(). Taps
+    // cost nothing while disabled. Muting takes a channel out of the mix but not out of its tap.
+    void setChannelTap(Channel channel, bool enabled);
+    int channelSamplesAvailable(Channel channel) const;
+    int readChannelSamples(Channel channel, int16_t *out, int count);
+    void setChannelMuted(Channel channel, bool muted);
+    bool isChannelMuted(Channel channel) const { return mutedChannels & (1 << static_cast<int>(channel)); }
+
+    bool frameIrqPending() const { return frameIrq; }
+    bool dmcIrqPending() const { return dmc.irq; }
+
+private:
+    struct Envelope
+    {
+        bool start = false;
+        bool loop = false;     // Also the length counter halt flag
+        bool constant = false;
+        uint8_t period = 0;    // Divider period, or the volume when constant
+        uint8_t divider = 0;
+        uint8_t decay = 0;
+
+        void clock();
+        int volume() const { return constant ? period : decay; }
+    };
+
+    struct Pulse
+    {
+        bool enabled = false;
+        bool twosComplementSweep = false; // Pulse 2 negates with two's complement, pulse 1 with ones'
+        uint8_t duty = 0;
+        uint8_t phase = 0;
+        uint8_t length = 0;
+        uint16_t period = 0;               // Timer reload; the sequencer steps every 2 * (period + 1) cycles
+        Envelope envelope;
+        bool sweepEnabled = false;
+        bool sweepNegate = false;
+        bool sweepReload = false;
+        uint8_t sweepPeriod = 0;
+        uint8_t sweepShift = 0;
+        uint8_t sweepDivider = 0;
+        int32_t nextClock = 0;
+        int output = 0;
+
+        uint16_t sweepTarget() const;
+        bool muted() const { return length == 0 || period < 8 || sweepTarget() > 0x7FF; }
+        void clockTimer(int32_t limit);
+        void clockSweep();
+        void updateOutput();
+    };
+
+    struct Triangle
+    {
+        bool enabled = false;
+        bool control = false;  // Also the length counter halt flag
+        bool linearReload = false;
+        uint8_t linearPeriod = 0;
+        uint8_t linearCounter = 0;
+        uint8_t length = 0;
+        uint8_t phase = 0;
+        uint16_t period = 0;   // The sequencer steps every period + 1 cycles
+        int32_t nextClock = 0;
+        int output = 0;
+
+        // Ultrasonic periods are held instead of played, like most emulators do, to avoid a
+        // flood of inaudible steps and the pop of the averaged level
+        bool stepping() const { return linearCounter > 0 && length > 0 && period >= 2; }
+        void clockTimer(int32_t limit);
+        void clockLinearCounter();
+    };
+
+    struct Noise
+    {
+        bool enabled = false;
+        bool shortMode = false;
+        uint8_t length = 0;
+        uint16_t period = 4;   // In CPU cycles
+        uint16_t shift = 1;    // 15-bit feedback shift register
+        Envelope envelope;
+        int32_t nextClock = 0;
+        int output = 0;
+
+        void clockTimer(int32_t limit);
+        void updateOutput();
+    };
+
+    struct DMC
+    {
+        bool irqEnabled = false;
+        bool loop = false;
+        bool irq = false;
+        uint16_t period = 428;  // In CPU cycles
+        uint16_t sampleAddress = 0xC000;
+        uint16_t sampleLength = 1;
+        uint16_t currentAddress = 0xC000;
+        uint16_t bytesRemaining = 0;
+        uint8_t sampleBuffer = 0;
+        bool bufferFull = false;
+        uint8_t shiftRegister = 0;
+        uint8_t bitsRemaining = 8;
+        bool silence = true;
+        int32_t nextClock = 0;
+        int output = 0;         // 7-bit output level
+
+        bool needsFetch() const { return !bufferFull && bytesRemaining > 0; }
+        void restart();
+        void clockTimer(int32_t limit);
+        void fetch(CPU *cpu);
+    };
+
+    int32_t currentCycle() const;
+    void runUntil(int32_t cycle);
+    void clockFrameCounter();
+    void quarterFrame();
+    void halfFrame();
+    void updateMix(int32_t time);
+    void updateTaps(int32_t time);
+    void updateIrq();
+    void scheduleDma(int32_t at);
+    void performDma();
+
+    Pulse pulse1;
+    Pulse pulse2;
+    Triangle triangle;
+    Noise noise;
+    DMC dmc;
+
+    // Frame counter
+    bool fiveStepMode;
+    bool irqInhibit;
+    bool frameIrq;
+    int frameStep;            // Next step of the sequence
+    int32_t nextFrameStep;    // Cycle of that step
+
+    int32_t dmaCycle;         // Pending DMC sample fetch, or NO_DMA
+    int32_t time;             // Cycle the channels have been run to
+    int mixLevel;             // Last mixed output, in MIX_SCALE units
+    BlipBuffer output;
+
+    uint8_t mutedChannels;    // One bit per Channel
+    bool tapsEnabled;         // Any tap
+    std::array<std::unique_ptr<BlipBuffer>, CHANNEL_COUNT> taps; // Null while disabled
+    std::array<int, CHANNEL_COUNT> tapLevels;
+
+    CPU *cpu;
+};
+
+#endif // APU_H
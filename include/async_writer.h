@@ -0,0 +1,62 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes buffers to a file or pipe on a background thread. Buffers come from a fixed pool
+// allocated up front: the producer acquires one, fills it and submits it, and the writer
+// thread returns it to the pool once written. When every buffer is queued, acquire() waits
+// for the writer (nothing is dropped), so the pool size sets how far I/O may fall behind.
+class AsyncFileWriter
+{
+public:
+    struct Buffer
+    {
+        std::vector<uint8_t> data; // Preallocated storage; grows only if a payload needs more
+        size_t size = 0;           // Bytes to write
+        std::string path;          // Write to this file instead of the open stream if not empty
+    };
+
+    AsyncFileWriter(int bufferCount, size_t bufferCapacity);
+    ~AsyncFileWriter();
+    AsyncFileWriter(const AsyncFileWriter &) = delete;
+    AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+    // Start the writer thread. path is the output stream ("-" for stdout), or empty when
+    // every buffer names its own file.
+    bool open(const std::string &path);
+    void close(); // Write everything still queued and stop the thread
+
+    Buffer &acquire();            // Free buffer from the pool, waiting for the writer if needed
+    void submit(Buffer &buffer);  // Queue a filled buffer for writing
+
+    bool failed() const;          // A write or file open failed
+    unsigned long stalls() const; // Times acquire() had to wait for the writer
+
+private:
+    void writerLoop();
+
+    std::vector<Buffer> buffers;
+    std::vector<Buffer *> freeBuffers;
+    std::deque<Buffer *> queue;
+
+    mutable std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable released;
+    std::thread writer;
+
+    FILE *file = nullptr;
+    bool ownsFile = false;
+    bool stopping = false;
+    bool error = false;
+    unsigned long stallCount = 0;
+};
+
+#endif // ASYNC_WRITER_H
@@ -0,0 +1,80 @@
+#ifndef AUDIO_DUMP_H
+#define AUDIO_DUMP_H
+
+#include "async_writer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Output formats of AudioDump
+enum class AudioFormat
+{
+    WAV,   // Mono 16-bit PCM RIFF/WAVE; sizes are filled in on close when the output is a file
+    RawPCM // Headerless signed 16-bit little-endian mono samples
+};
+
+// Streams the APU's output to disk or a pipe. Samples are taken at the APU's nominal rate,
+// before any resampling for the audio device, so the file depends only on emulated time and
+// not on how fast emulation ran. They are packed into blocks from an AsyncFileWriter pool and
+// written on its thread; a block goes out once it is full, about every 0.75s of audio.
+class AudioDump
+{
+public:
+    AudioDump();
+
+    // path is the output file, "-" for stdout. A WAV stream on stdout cannot be rewound, so its
+    // sizes are left at the 0xFFFFFFFF "unknown length" value that decoders read to the end.
+    bool open(const std::string &path, AudioFormat format, int sampleRate);
+    void writeSamples(const int16_t *samples, size_t count);
+    void close();
+
+    bool isOpen() const { return opened; }
+    bool failed() const { return error || writer.failed(); }
+    unsigned long stalls() const { return writer.stalls(); }
+    uint64_t samplesWritten() const { return sampleCount; }
+
+    // Pick a format from a file name: .raw/.pcm or .wav (defaults to WAV, e.g. for "-")
+    static AudioFormat formatForPath(const std::string &path);
+
+private:
+    void flush();
+    void finishHeader();
+
+    AsyncFileWriter writer;
+    AsyncFileWriter::Buffer *block; // Block being filled, or null
+    AudioFormat format;
+    std::string path;
+    int sampleRate;
+    bool opened;
+    bool error;
+    uint64_t sampleCount;
+};
+
+// Fingerprint of the audio output for golden-value tests: a hash of the samples of every
+// framesPerHash frames. Each frame's samples are hashed whole and chained into the group's hash
+// (hash64 seeded with the previous value), so the result does not depend on how the samples
+// of a frame were read, and changes if a single sample does.
+class AudioHash
+{
+public:
+    explicit AudioHash(int framesPerHash);
+
+    void addSamples(const int16_t *samples, size_t count);
+
+    // Close a frame; true when it completes a group, whose hash is then value()
+    bool endFrame();
+
+    uint64_t value() const { return lastHash; }
+    unsigned long groups() const { return groupCount; } // Completed groups so far
+
+private:
+    std::vector<int16_t> frameSamples;
+    int framesPerHash;
+    int frameCount;
+    uint64_t runningHash;
+    uint64_t lastHash;
+    unsigned long groupCount;
+};
+
+#endif // AUDIO_DUMP_H
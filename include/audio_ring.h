@@ -0,0 +1,111 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring of int16 samples, from the emulation thread
+// to the audio device callback. Push and pop are wait-free and never allocate. Each side
+// keeps a cached copy of the other side's index so it only touches the shared cache line when
+// the cached value says the ring looks full (producer) or empty (consumer).
+//
+// When the ring runs dry, pop() fades the last sample to silence instead of cutting to zero,
+// so an underrun is a short dip rather than a click. When it is full, push() drops the newest
+// samples. Both are counted.
+class AudioRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit AudioRing(size_t capacity)
+        : writeIndex(0), cachedReadIndex(0), droppedSamples(0),
+          readIndex(0), cachedWriteIndex(0), lastSample(0), underrunCount(0), underrunSamples(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        samples.assign(size, 0);
+        mask = size - 1;
+    }
+
+    // Producer: append up to count samples; returns how many fit
+    size_t push(const int16_t *data, size_t count)
+    {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        if (samples.size() - (write - cachedReadIndex) < count)
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+        size_t n = std::min(count, samples.size() - (write - cachedReadIndex));
+
+        size_t start = write & mask;
+        size_t first = std::min(n, samples.size() - start);
+        memcpy(&samples[start], data, first * sizeof(int16_t));
+        memcpy(&samples[0], data + first, (n - first) * sizeof(int16_t));
+        writeIndex.store(write + n, std::memory_order_release);
+
+        if (n < count)
+            droppedSamples.store(droppedSamples.load(std::memory_order_relaxed) + (count - n), std::memory_order_relaxed);
+        return n;
+    }
+
+    // Consumer: always fills all count samples; returns how many came from the ring, the rest
+    // are the fade-out
+    size_t pop(int16_t *out, size_t count)
+    {
+        size_t read = readIndex.load(std::memory_order_relaxed);
+        if (cachedWriteIndex - read < count)
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+        size_t n = std::min(count, cachedWriteIndex - read);
+
+        size_t start = read & mask;
+        size_t first = std::min(n, samples.size() - start);
+        memcpy(out, &samples[start], first * sizeof(int16_t));
+        memcpy(out + first, &samples[0], (n - first) * sizeof(int16_t));
+        readIndex.store(read + n, std::memory_order_release);
+
+        if (n > 0)
+            lastSample = out[n - 1];
+        if (n < count)
+        {
+            for (size_t i = n; i < count; ++i)
+            {
+                lastSample -= (lastSample + (lastSample > 0 ? 15 : -15)) / 16; // Silent after about 4ms at 44.1kHz
+                out[i] = lastSample;
+            }
+            underrunCount.store(underrunCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            underrunSamples.store(underrunSamples.load(std::memory_order_relaxed) + (count - n), std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    // Telemetry, safe to read from any thread
+    size_t fillLevel() const
+    {
+        size_t read = readIndex.load(std::memory_order_acquire); // First, so it can never pass the write index
+        return writeIndex.load(std::memory_order_acquire) - read;
+    }
+    size_t capacity() const { return samples.size(); }
+    uint64_t dropped() const { return droppedSamples.load(std::memory_order_relaxed); }
+    uint64_t underruns() const { return underrunCount.load(std::memory_order_relaxed); }
+    uint64_t missingSamples() const { return underrunSamples.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<int16_t> samples;
+    size_t mask;
+
+    // Producer side
+    alignas(64) std::atomic<size_t> writeIndex;
+    size_t cachedReadIndex;
+    std::atomic<uint64_t> droppedSamples;
+
+    // Consumer side
+    alignas(64) std::atomic<size_t> readIndex;
+    size_t cachedWriteIndex;
+    int16_t lastSample;
+    std::atomic<uint64_t> underrunCount;
+    std::atomic<uint64_t> underrunSamples;
+};
+
+#endif // AUDIO_RING_H
@@ -0,0 +1,56 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// Band-limited step synthesis. Sound generators report only the moments their amplitude
+// changes, as deltas timestamped in source clocks; each delta is added as a band-limited step
+// (windowed-sinc kernel) into a buffer at the output rate. Reading integrates the buffer, so
+// the cost is per amplitude change and per output sample, never per source clock.
+//
+// Time stamps are relative to the start of the current frame. endFrame() closes the frame and
+// makes its samples readable; deltas may be added past the end of the frame, they simply land
+// in the next one.
+class BlipBuffer
+{
+public:
+    static constexpr int PHASE_BITS = 5;                // Sub-sample resolution of step times
+    static constexpr int PHASES = 1 << PHASE_BITS;
+    static constexpr int KERNEL_TAPS = 16;               // Kernel width in output samples
+    static constexpr int KERNEL_UNIT = 1 << 15;          // Sum of each kernel phase
+
+    // capacity is the most samples that can be waiting to be read
+    BlipBuffer(double clockRate, int sampleRate, int capacity);
+
+    void clear();
+
+    // Amplitude change of delta (in output sample units) at clock time
+    void addDelta(int32_t time, int delta);
+
+    // End the frame after duration clocks. Samples that nobody read are dropped, oldest first,
+    // once the buffer would overflow.
+    void endFrame(int32_t duration);
+
+    int samplesAvailable() const { return available; }
+
+    // Remove up to count samples into out; returns how many were read
+    int readSamples(int16_t *out, int count);
+
+    double getClockRate() const { return clockRate; }
+    int getSampleRate() const { return sampleRate; }
+
+private:
+    void removeSamples(int count);
+
+    double clockRate;
+    int sampleRate;
+    int capacity;
+    uint64_t factor;         // Output samples per clock, 32.32 fixed point
+    uint64_t offset;         // Start of the current frame in output samples, 32.32 fixed point
+    int available;           // Complete samples before the current frame
+    int32_t integrator;      // Running sum of the deltas, KERNEL_UNIT per output unit
+    std::vector<int32_t> deltas; // Kernel contributions waiting to be integrated
+};
+
+#endif // BLIP_BUFFER_H
@@ -0,0 +1,82 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include "mapped_file.h"
+#include "ppu.h" // For Mirroring
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CPU;
+class Mapper;
+
+// An iNES cartridge: PRG-ROM, CHR-ROM or 8KB of CHR-RAM, 8KB of PRG-RAM at $6000, and the
+// mapper that banks them. Bank data never moves. The CPU reads $8000-$FFFF through four 8KB
+// page pointers and the PPU reads $0000-$1FFF through eight 1KB page pointers
+// (PPU::setChrPage), and a bank switch only rewrites those pointers. ROM loaded from a file
+// is never copied: the pointers aim into a read-only mapping of it.
+class Cartridge
+{
+public:
+    Cartridge();
+    ~Cartridge();
+    Cartridge(const Cartridge &) = delete;
+    Cartridge &operator=(const Cartridge &) = delete;
+
+    // Parse an iNES image; false, with the reason on std::cerr, for invalid or unsupported ones.
+    // A file is mapped in place; an image in memory is copied.
+    bool load(const std::string &path);
+    bool load(const uint8_t *image, size_t size);
+
+    // Map the banks into the CPU and PPU and reset the mapper
+    void connect(CPU *cpuInstance, PPU *ppuInstance);
+
+    uint8_t readPrg(uint16_t address) const { return prgPages[(address >> 13) & 3][address & 0x1FFF]; }
+    uint8_t readPrgRam(uint16_t address) const { return prgRam[address & 0x1FFF]; }
+    void writePrgRam(uint16_t address, uint8_t value) { prgRam[address & 0x1FFF] = value; }
+    void writeRegister(uint16_t address, uint8_t value); // CPU writes to $8000-$FFFF
+
+    // Mapper timing, in CPU cycles of the current frame like CPU::cycles
+    int nextEventCycle() const;          // Next cycle the mapper may raise an IRQ, or INT_MAX
+    void catchUp(int cycle);             // Run the mapper's counters up to a cycle
+    void endFrame(int frameCycles);
+
+    int getMapperNumber() const { return mapperNumber; }
+    size_t getPrgSize() const { return prgSize; }
+    size_t getChrSize() const { return chrSize; }
+    bool hasChrRam() const { return chrRam; }
+
+    // Bank switching, for mappers. Bank numbers wrap around the ROM size; negative ones count
+    // from the last bank.
+    void mapPrg(int slot, int bank); // 8KB bank into $8000 + slot * $2000
+    void mapChr(int slot, int bank); // 1KB bank into PPU $0000 + slot * $400
+    void setMirroring(Mirroring mode); // Ignored on four-screen boards
+    void setIrq(bool active);
+    bool renderingEnabled() const;     // PPUMASK shows background or sprites
+
+private:
+    bool parse(const uint8_t *image, size_t size); // Point the banks into image, which must stay alive
+
+    MappedFile file;                 // The ROM file, when loaded from one
+    std::vector<uint8_t> imageCopy;  // The image, when loaded from memory
+    const uint8_t *prgRom;
+    uint8_t *chrMemory;              // CHR-ROM inside the image, or chrRamData
+    std::vector<uint8_t> chrRamData;
+    std::array<uint8_t, 0x2000> prgRam;
+    size_t prgSize;
+    size_t chrSize;
+    bool chrRam;
+    bool fourScreen;
+    Mirroring headerMirroring;
+    int mapperNumber;
+
+    std::array<const uint8_t *, 4> prgPages;
+    std::unique_ptr<Mapper> mapper;
+    CPU *cpu;
+    PPU *ppu;
+};
+
+#endif // CARTRIDGE_H
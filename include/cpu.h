@@ -6,11 +6,14 @@
 #include <functional>
 #include <unordered_map>
 #include <string>
+#include <climits>
 
 
 
 class CPU;
 class PPU;
+class APU;
+class Cartridge;
 
 
 
@@ -60,6 +63,27 @@ public:
     // NMI Flag
     bool nmiRequested = false; // Indicates whether an NMI has been requested
 
+    // IRQ: a level-sensitive line shared by several sources, one bit each. The line is polled
+    // between instructions through nextEventCycle, which is forced to INT_MIN only while an
+    // IRQ is pending and enabled, so the instruction loop checks nothing extra otherwise.
+    enum IrqSource : uint8_t {
+        IRQ_APU_FRAME = 0x01, // Frame counter
+        IRQ_APU_DMC = 0x02,   // DMC sample end
+        IRQ_MAPPER = 0x04     // Cartridge, e.g. the MMC3 scanline counter
+    };
+    uint8_t irqLine = 0;          // Sources holding the line low
+    bool irqPollDelayed = false;  // CLI, SEI or PLP ran: the next poll sees the previous I flag
+    bool irqPollDisabled = false; // That previous I flag
+
+    // Events: runUntil() stops after the instruction that reaches nextEventCycle (cycles >=
+    // nextEventCycle) to let the APU perform its DMC fetches, which halt the CPU, and raise its
+    // interrupts, and to poll the IRQ line. OAM DMA halts the CPU for 513 or 514 cycles.
+    int nextEventCycle = INT_MAX;
+    int runTarget = INT_MAX; // targetCycle of the runUntil() in progress
+    int runLimit = INT_MIN;  // Lower of runTarget and nextEventCycle: the instruction loop's only bound
+    int oamDmaEnd = INT_MIN;  // Cycle the last OAM DMA finished
+    bool oddFrameStart = false; // Parity of the absolute cycle count at cycles == 0
+
 
     // Memory
     std::array<uint8_t, 0x10000> memory{}; // 64KB of memory
@@ -68,16 +92,26 @@ public:
     void reset();
     void execute();
     void executeWithCycles();
+    void runUntil(int targetCycle); // Execute whole instructions until cycles reaches targetCycle
+    void endFrame(int frameCycles);  // Rebase cycles to the start of the next frame
+    void serviceEvents();
+    void refreshEventCycle();         // Recompute nextEventCycle after a change of state
+    void stallForDmc(int fetchCycle); // Charge a DMC sample fetch made at fetchCycle
     void loadROM(const std::string& filename);
     void printMemory(uint16_t start, uint16_t end);
     void dumpMemoryToConsole(uint16_t start, uint16_t end);
     void handleUndefinedOpcode(uint8_t opcode);
     void requestNMI();
     void handleNMI();
+    void setIrq(uint8_t source, bool active);
+    void handleIRQ();
+    void delayInterruptPoll(bool previousDisabled); // For CLI, SEI and PLP
     void debugNMIVector();
     void writeMemory(uint16_t address, uint8_t value);
     uint8_t readMemory(uint16_t address);
     void setPPU(PPU* ppuInstance);
+    void setAPU(APU* apuInstance);
+    void setCartridge(Cartridge* cartridgeInstance);
 
     // Opcode Table
     using OpcodeFunction = std::function<void(CPU&)>;
@@ -169,6 +203,8 @@ public:
 
 private:
  PPU* ppu = nullptr;
+ APU* apu = nullptr;
+ Cartridge* cartridge = nullptr;
 
 
 };
@@ -0,0 +1,63 @@
+#ifndef DIRTY_ROWS_H
+#define DIRTY_ROWS_H
+
+#include "ppu.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+// Tracks which scanlines of a new frame differ from the last frame a frontend presented, using
+// the row hashes the PPU takes while drawing. It lives on the presenting side because only the
+// frontend knows which frames it actually showed (the triple buffer drops frames it misses).
+class DirtyRowTracker
+{
+public:
+    DirtyRowTracker() : valid(false) {}
+
+    // Compare frame with the last presented one and remember it as presented. Returns the
+    // number of rows that changed; every row is dirty the first time and after invalidate().
+    int update(const Frame &frame)
+    {
+        dirty.reset();
+        for (int row = 0; row < 240; ++row)
+        {
+            if (!valid || frame.rowHashes[row] != presented[row])
+                dirty.set(row);
+        }
+        presented = frame.rowHashes;
+        valid = true;
+        return static_cast<int>(dirty.count());
+    }
+
+    void invalidate() { valid = false; } // The presented image was lost, e.g. a new texture
+
+    bool isDirty(int row) const { return dirty.test(row); }
+
+    // Call fn(begin, end) for every run of consecutive dirty rows
+    template <typename Fn>
+    void forEachDirtyRange(Fn fn) const
+    {
+        int row = 0;
+        while (row < 240)
+        {
+            if (!dirty.test(row))
+            {
+                ++row;
+                continue;
+            }
+            int begin = row;
+            while (row < 240 && dirty.test(row))
+            {
+                ++row;
+            }
+            fn(begin, row);
+        }
+    }
+
+private:
+    std::array<uint64_t, 240> presented;
+    std::bitset<240> dirty;
+    bool valid;
+};
+
+#endif // DIRTY_ROWS_H
@@ -0,0 +1,14 @@
+#ifndef FRAME_HASH_H
+#define FRAME_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit xxHash (XXH64) of a block of memory. Used to fingerprint framebuffer rows and whole
+// frames for golden-value regression tests and for skipping unchanged frames.
+uint64_t hash64(const void *data, size_t length, uint64_t seed = 0);
+
+// Hash of a whole frame, combined from its per-row hashes
+uint64_t hashFrameRows(const uint64_t *rowHashes, int rows);
+
+#endif // FRAME_HASH_H
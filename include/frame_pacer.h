@@ -0,0 +1,72 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// What decides when the next frame may start
+enum class SyncSource
+{
+    WallClock,  // Steady clock at the console's frame rate
+    Vsync,      // The presenting thread's display refresh (see signalVsync())
+    AudioQueue  // Keep the audio output queue near a target depth
+};
+
+// Paces the emulation loop. Waits use the steady clock: a sleep for most of the remaining
+// time, then a short spin to the deadline, because sleeps overshoot by up to a millisecond or
+// more. Deviations of the frame interval from the nominal period are kept in a histogram.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double NTSC_FRAME_RATE = 39375000.0 / 655171.0; // 60.0988 Hz
+
+    // Jitter histogram: buckets of 0.5ms from -8ms to +8ms; the outer buckets collect the rest
+    static constexpr int JITTER_BUCKETS = 33;
+    static constexpr double JITTER_BUCKET_MS = 0.5;
+
+    explicit FramePacer(double frameRate = NTSC_FRAME_RATE);
+
+    void setSyncSource(SyncSource source);
+    SyncSource getSyncSource() const { return source; }
+
+    // AudioQueue source: queuedSeconds reports how much audio is waiting to be played; frames
+    // are held back while it is above targetSeconds
+    void setAudioQueue(std::function<double()> queuedSeconds, double targetSeconds);
+
+    void waitForNextFrame(); // Called once per frame by the emulation loop
+    void signalVsync();      // Vsync source: the presenting thread finished a refresh
+    void reset();            // Restart timing, e.g. after a pause
+
+    const std::array<uint32_t, JITTER_BUCKETS> &jitterHistogram() const { return histogram; }
+    std::string formatJitterHistogram() const;
+
+private:
+    void waitUntil(Clock::time_point deadline);
+    void recordInterval(Clock::time_point now);
+
+    SyncSource source;
+    Clock::duration period;
+    Clock::duration spinThreshold; // Spin instead of sleeping this close to the deadline
+    Clock::time_point deadline;
+    Clock::time_point lastFrame;
+    bool started;
+
+    std::function<double()> audioQueued;
+    double audioTarget;
+
+    std::mutex vsyncMutex;
+    std::condition_variable vsyncSignal;
+    uint64_t vsyncCount;
+    uint64_t vsyncSeen;
+
+    std::array<uint32_t, JITTER_BUCKETS> histogram;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,41 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+
+class Cartridge;
+
+// Bank switching logic of a cartridge board. A mapper sees the CPU's writes to $8000-$FFFF
+// and answers them by remapping the cartridge's page pointers (Cartridge::mapPrg/mapChr);
+// it never touches bank data. Mappers with a scanline counter also keep time, in CPU
+// cycles of the current frame, so the CPU can stop for their interrupts (Cartridge::nextEventCycle).
+class Mapper
+{
+public:
+    explicit Mapper(Cartridge &cartridge) : cartridge(cartridge) {}
+    virtual ~Mapper() = default;
+
+    virtual void reset() = 0; // Power-on banks
+    virtual void writeRegister(uint16_t address, uint8_t value) = 0;
+
+    virtual int nextIrqCycle() const { return INT_MAX; }
+    virtual void catchUp(int /*cycle*/) {}
+    virtual void endFrame(int /*frameCycles*/) {}
+
+    // Supported boards: 0 NROM, 1 MMC1, 2 UxROM, 3 CNROM, 4 MMC3, 7 AxROM. Null otherwise.
+    static std::unique_ptr<Mapper> create(int number, Cartridge &cartridge);
+
+protected:
+    // Larger banks, as runs of 8KB PRG and 1KB CHR pages
+    void mapPrg16(int slot, int bank);
+    void mapPrg32(int bank);
+    void mapChr2(int slot, int bank);
+    void mapChr4(int slot, int bank);
+    void mapChr8(int bank);
+
+    Cartridge &cartridge;
+};
+
+#endif // MAPPER_H
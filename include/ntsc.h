@@ -0,0 +1,23 @@
+#ifndef NTSC_H
+#define NTSC_H
+
+#include <cstdint>
+
+class WorkerPool;
+
+// NTSC composite video filter in the style of blargg's nes_ntsc. Every pixel is turned into
+// the PPU's composite signal and decoded again, which gives the colour fringing, dot crawl
+// and blending of a real TV. Decoding is linear, so the contribution of every colour to the
+// output pixels around it is precomputed once and a frame is just a sum of table entries.
+
+// Output pixels per scanline: two per PPU pixel
+constexpr int NTSC_OUTPUT_WIDTH = 512;
+
+// Filter a 256-pixel-wide frame of palette indices (see PPU::framebuffer) with one emphasis
+// value per row into ARGB8888. framePhase (0-2) is the colour subcarrier phase of the first
+// scanline; cycling it from frame to frame produces dot crawl. pitch is the output row stride
+// in bytes. With a pool, rows are split across its workers.
+void ntscFilterFrame(const uint8_t *indices, const uint8_t *lineEmphasis, int height, int framePhase,
+                     uint32_t *output, int pitch, WorkerPool *pool = nullptr);
+
+#endif // NTSC_H
@@ -0,0 +1,25 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstdint>
+
+// Output formats for converting the PPU's indexed framebuffer
+enum class PixelFormat
+{
+    ARGB8888, // 32-bit, matches SDL_PIXELFORMAT_ARGB8888
+    RGB565,   // 16-bit
+    Indexed   // Raw 6-bit palette indices, one byte per pixel (emphasis dropped)
+};
+
+// 64-entry master palette as ARGB8888 with the given emphasis bits (PPUMASK bits 5-7, shifted down)
+const uint32_t *paletteARGB(uint8_t emphasis);
+
+// 64-entry master palette as RGB565 with the given emphasis bits
+const uint16_t *paletteRGB565(uint8_t emphasis);
+
+// Convert a frame of palette indices to the target format. lineEmphasis holds one emphasis
+// value per row; pitch is the output row stride in bytes.
+void convertFrame(const uint8_t *indices, const uint8_t *lineEmphasis, int width, int height,
+                  PixelFormat format, void *output, int pitch);
+
+#endif // PALETTE_H
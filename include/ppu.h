@@ -3,8 +3,59 @@
 
 #include <cstdint>
 #include <array>
+#include <memory>
+#include <vector>
 
 class CPU; 
+class WorkerPool;
+
+// Nametable mirroring arrangements selected by the cartridge or mapper
+enum class Mirroring
+{
+    Horizontal,    // $2000=$2400, $2800=$2C00 (vertical scrolling games)
+    Vertical,      // $2000=$2800, $2400=$2C00 (horizontal scrolling games)
+    SingleScreenA, // All four nametables map to the first 1KB page
+    SingleScreenB, // All four nametables map to the second 1KB page
+    FourScreen     // Four independent nametables (extra cartridge VRAM)
+};
+
+// A completed frame as handed from the emulation core to a frontend
+struct Frame
+{
+    std::array<uint8_t, 256 * 240> pixels; // Palette indices, see PPU::framebuffer
+    std::array<uint8_t, 240> emphasis;     // Emphasis bits of each scanline
+    std::array<uint64_t, 240> rowHashes;   // Hash of each scanline's pixels and emphasis
+    uint64_t hash;                         // Hash of the whole frame, see hashFrameRows()
+};
+
+// What a write log entry records
+enum class RegisterAccess : uint8_t
+{
+    Write,     // CPU write to register reg
+    Read,      // CPU read with side effects ($2002 resets the latches, $2007 moves the address)
+    FrameStart // Internal state at the start of the frame; reg is a RegisterWrite::Field
+};
+
+// One entry of the write log: a CPU access to a PPU register, or one field of the state the
+// frame started with
+struct RegisterWrite
+{
+    // FrameStart fields, logged in this order when a frame begins
+    enum Field : uint8_t
+    {
+        CTRL, MASK, STATUS, OAM_ADDRESS, SCROLL_X, SCROLL_Y, VRAM_HIGH, VRAM_LOW,
+        LATCHES, // Bit 0: PPUADDR latch, bit 1: PPUSCROLL latch
+        FIELD_COUNT
+    };
+
+    uint32_t frame;   // Frame number (see PPU::getFrameCount) the entry belongs to
+    int32_t cycle;    // CPU cycle within the frame, counted from the start of VBlank
+    int16_t scanline; // 0-239 visible, 240 post-render, 241-260 VBlank, 261 pre-render
+    uint16_t dot;     // PPU dot within the scanline (0-340)
+    uint8_t reg;      // Register number, 0-7 for $2000-$2007, or a Field
+    uint8_t value;    // Byte written or read, or the field's value
+    RegisterAccess access;
+};
 
 class PPU {
 public:
@@ -23,34 +74,178 @@ public:
     std::array<uint8_t, 256> oam;       // Sprite memory (Object Attribute Memory)
 
     // Framebuffer
-    std::array<uint32_t, 256 * 240> framebuffer; // RGB frame buffer
+    std::array<uint8_t, 256 * 240> framebuffer; // 6-bit palette indices, converted with convertFrame() (palette.h)
+    std::array<uint8_t, 240> lineEmphasis;      // Colour emphasis bits (PPUMASK bits 5-7) of each scanline
+    std::array<uint8_t, 256 * 240> backgroundOpaque; // Non-zero where the background pixel is opaque
+    std::array<uint64_t, 240> rowHashes;        // hash64() of each drawn row, seeded with its emphasis
+
+    // Secondary OAM for one scanline (up to 8 sprites, in OAM priority order)
+    struct SpriteLine
+    {
+        uint8_t count;              // Number of sprites selected for this line
+        bool overflow;              // More than 8 sprites were in range
+        bool hasSpriteZero;         // Entry 0 is OAM sprite 0
+        std::array<uint8_t, 32> oam; // Copied Y, tile, attribute and X bytes
+    };
+
+    // Register state latched at the start of a visible scanline
+    struct ScanlineState
+    {
+        uint8_t ctrl;    // PPUCTRL
+        uint8_t mask;    // PPUMASK
+        uint8_t scrollX; // PPUSCROLL first write
+        uint8_t scrollY; // PPUSCROLL second write
+    };
+
+    // CHR page of each 1KB pattern slot ($0000-$1FFF), as the renderer reads it
+    using ChrPages = std::array<const uint8_t *, 8>;
+
+    // Everything the renderer reads for one frame. It is captured when the frame ends so
+    // the pixels can be drawn on worker threads while the CPU runs the next frame.
+    struct FrameState
+    {
+        std::array<ScanlineState, 240> scanlines;
+        std::array<SpriteLine, 240> spriteLines;
+        std::array<uint8_t, 0x4000> memory;     // Nametables and palettes; patterns come from chrPages
+        std::array<ChrPages, 240> chrPages;     // Pattern pages of each scanline
+        std::vector<std::array<uint8_t, 0x400>> chrCopies; // Copies of the writable (CHR-RAM) pages
+        std::vector<const uint8_t *> chrSources;           // Page each copy was taken from
+        std::array<uint16_t, 4> nametablePages; // Offsets of the nametable slots into memory
+        std::array<std::array<uint8_t, 32 * 30>, 4> attributes; // Attribute cache of each page
+    };
+
+    // Frame timing, in CPU cycles from the start of VBlank (scanline 241)
+    static constexpr int CPU_CYCLES_PER_FRAME = 29781; // 341 dots x 262 scanlines / 3
+    static int scanlineStartCycle(int scanline) { return ((21 + scanline) * 341) / 3; }
 
     // Methods
     PPU();
+    ~PPU();
+    PPU(const PPU &) = delete;            // Nametable slots point into this instance's memory
+    PPU &operator=(const PPU &) = delete;
     void reset();
     void writeRegister(uint16_t address, uint8_t value);
     uint8_t readRegister(uint16_t address);
     void renderFrame();
+    void copyFrame(Frame &frame); // Copy the last rendered frame out of the PPU
+    uint64_t frameHash();         // Hash of the last rendered frame (same as Frame::hash)
     void renderBackground();
     void renderSprites();
+    void setRenderThreads(int count); // 0 renders on the calling thread
+    void waitForFrame();              // Block until the frame handed to the workers is drawn
+    void syncScanlines(int cycle);    // Latch scanline state and status flags up to a CPU cycle
+    const ScanlineState &getScanlineState(int scanline) const { return scanlineLog[scanline]; }
+    const ChrPages &getScanlineChrPages(int scanline) const { return scanlineChrPages[scanline]; }
+    void evaluateSprites();
+    const SpriteLine &getSpriteLine(int scanline) const { return spriteLines[scanline]; }
+    void invalidateSpriteCache() { oamDirty = true; } // Call after writing oam[] directly
+    void invalidateAttributeCache() { attributesDirty = true; } // Call after writing nametables in memory[] directly
+    uint8_t getTilePalette(int page, int tileX, int tileY) const { return attributeCache[page][tileY * 32 + tileX] >> 2; }
     void setCPU(CPU* cpuInstance); // Method to link CPU to PPU
     public:
     uint8_t getFineXScroll() const { return fineXScroll; }
     uint8_t getFineYScroll() const { return fineYScroll; }
     void clearVBlankFlag();
     uint16_t resolveNametableAddress(uint16_t address);
+    void setMirroring(Mirroring mode);
+    Mirroring getMirroring() const { return mirroring; }
+    // Pattern tables: the cartridge maps a 1KB page of CHR memory into each of the eight
+    // slots of $0000-$1FFF. Without one they map memory[$0000-$1FFF], writable. Scanlines the
+    // CPU has already passed keep the pages they were latched with.
+    void setChrPage(int slot, uint8_t *page);
+    void setChrWritable(bool writable) { chrWritable = writable; }
+    const uint8_t *patternData(uint16_t address) const { return &chrPages[address >> 10][address & 0x3FF]; }
+    uint8_t readPalette(uint8_t entry) const; // Palette RAM lookup for entries 0-31
     void debugPatternTable();
     void writeDMA(uint8_t value);
     void debugNametable(uint16_t nametableBase);
 
+    // Debug viewers (ppu_viewer.cpp): draw PPU state as ARGB8888 images into caller buffers,
+    // pitch in bytes. Nothing is drawn unless a viewer asks for it.
+    static constexpr int PATTERN_VIEW_WIDTH = 256;    // Both pattern tables side by side
+    static constexpr int PATTERN_VIEW_HEIGHT = 128;
+    static constexpr int NAMETABLE_VIEW_WIDTH = 512;  // The four nametables, 2x2
+    static constexpr int NAMETABLE_VIEW_HEIGHT = 480;
+    static constexpr int SPRITE_VIEW_WIDTH = 64;      // 8x8 grid of 8x16 cells, in OAM order
+    static constexpr int SPRITE_VIEW_HEIGHT = 128;
+    static constexpr int PALETTE_VIEW_WIDTH = 256;    // 16x2 swatches: background, then sprites
+    static constexpr int PALETTE_VIEW_HEIGHT = 32;
+    void viewPatternTables(uint32_t *output, int pitch, uint8_t palette) const; // palette 0-7
+    void viewNametables(uint32_t *output, int pitch, bool scrollWindow = true) const;
+    void viewSprites(uint32_t *output, int pitch) const;
+    void viewPalettes(uint32_t *output, int pitch) const;
+
+    // Register write log: a preallocated ring of the most recent register writes, the reads
+    // that change state, and the latches, scroll and address each frame started with. OAM DMA
+    // is logged as the 256 OAMDATA writes it performs.
+    void enableWriteLog(size_t capacity); // Rounded up to a power of two, 0 turns logging off
+    uint32_t getFrameCount() const { return frameCount; }
+    std::vector<RegisterWrite> getFrameWrites(uint32_t frame) const; // Entries of a frame still in the ring
+    // Restore the frame's start state, apply its accesses at their original cycles, then render
+    // the frame. The PPU must hold the memory and OAM contents of the start of that frame; the
+    // replay is exact when the ring still holds the frame's start entries.
+    void replayFrame(const std::vector<RegisterWrite> &writes);
+
 
 private:
     // Internal PPU State
     bool addressLatch;      // Tracks high/low byte writes for PPUADDR ($2006)
     bool scrollLatch;       // Tracks first/second write for PPUSCROLL ($2005)
+    uint16_t vramAddress;   // 14-bit VRAM address set through PPUADDR ($2006)
     uint8_t fineXScroll;    // Fine X scroll value
     uint8_t fineYScroll;    // Fine Y scroll value
 
+    // Per-scanline sprite lists, rebuilt only when OAM changes
+    std::array<SpriteLine, 240> spriteLines;
+    bool oamDirty;
+
+    // Nametable slots: the 1KB page of memory[$2000-$2FFF] seen at each of the four
+    // nametable positions. Every nametable access is slot[(addr >> 10) & 3][addr & 0x3FF].
+    uint8_t *nametableSlots[4];
+    Mirroring mirroring;
+
+    // CHR page of each 1KB pattern slot; written through PPUDATA only when chrWritable (CHR-RAM)
+    std::array<uint8_t *, 8> chrPages;
+    bool chrWritable;
+
+    // Palette select of every tile of the four physical nametable pages, stored as the first
+    // palette entry (0, 4, 8 or 12). Updated when an attribute byte is written.
+    std::array<std::array<uint8_t, 32 * 30>, 4> attributeCache;
+    bool attributesDirty;
+
+    // Scanline timing for the frame in progress
+    std::array<ScanlineState, 240> scanlineLog; // Register snapshot of every visible scanline
+    std::array<ChrPages, 240> scanlineChrPages; // CHR pages of every visible scanline
+    int nextScanline;        // First scanline not latched yet
+    bool preRenderDone;      // Pre-render line has cleared the status flags
+    int spriteZeroHitCycle;  // Cycle of a pending sprite 0 hit, or -1
+
+    // Deferred rendering
+    FrameState frameState;
+    std::unique_ptr<WorkerPool> renderPool;
+    bool frameInFlight;
+
+    // Register write log
+    std::vector<RegisterWrite> writeLog;
+    size_t writeLogCount;   // Total writes logged, the ring index is writeLogCount & (size - 1)
+    uint32_t frameCount;    // Frames rendered since power-on
+    int replayCycle;        // Timing source while no CPU is linked
+
+    int currentCycle() const;
+    void logAccess(RegisterAccess access, uint8_t reg, uint8_t value);
+    void logFrameStart();
+    void restoreField(uint8_t field, uint8_t value); // Apply a FrameStart entry
+    void updateAttribute(int page, int index, uint8_t value);
+    void rebuildAttributeCache();
+    void latchScanline(int scanline);
+    int findSpriteZeroHit(int scanline) const;
+    void captureFrameState(bool wholeFrameFromRegisters);
+    void copyWritableChrPages();
+    void drawLines(int begin, int end);
+    void drawBackgroundLine(int scanline);
+    void drawSpriteLine(int scanline);
+    void hashLine(int scanline);
+
     CPU* cpu; // Pointer to the CPU for signaling NMI interrupts
 };
 
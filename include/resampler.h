@@ -0,0 +1,59 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-point polyphase resampler for int16 audio at ratios close to 1. Used for dynamic rate
+// control: the APU produces samples at the emulated clock while the audio device consumes them
+// at its own, so the stream is stretched or squeezed by a fraction of a percent to keep the
+// output queue at a constant depth.
+class Resampler
+{
+public:
+    static constexpr int TAPS = 8;         // Input samples per output sample
+    static constexpr int PHASE_BITS = 6;   // 64 sub-sample kernel phases
+    static constexpr int PHASES = 1 << PHASE_BITS;
+
+    Resampler();
+
+    void reset();
+
+    // Output samples per input sample
+    void setRatio(double ratio);
+    double getRatio() const { return ratio; }
+
+    // Resample count input samples into out; returns the number of samples written. Input
+    // that does not fit in outCapacity is kept for the next call. Output lags the input by
+    // TAPS / 2 samples.
+    size_t process(const int16_t *in, size_t count, int16_t *out, size_t outCapacity);
+
+private:
+    double ratio;
+    uint64_t step;                  // Input samples per output sample, 32.32 fixed point
+    uint64_t position;              // Next output position in pending, 32.32 fixed point
+    std::vector<int16_t> pending;   // Input history and samples not consumed yet
+};
+
+// Dynamic rate control: picks the resampling ratio from the depth of the output queue. A
+// queue below the target gets slightly more samples, one above it slightly fewer, never more
+// than maxDeviation away from 1. The depth is smoothed first, because it is only sampled once
+// per frame and jumps by a frame's worth of samples depending on when the device last pulled.
+class RateControl
+{
+public:
+    explicit RateControl(double targetSamples, double maxDeviation = 0.005);
+
+    double update(size_t queuedSamples); // Returns the ratio for the next frame
+
+    double getTarget() const { return target; }
+
+private:
+    double target;
+    double maxDeviation;
+    double smoothed;
+    bool started;
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,45 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <cstdint>
+
+class WorkerPool;
+
+// Software upscalers for frames converted with convertFrame() (palette.h). Each one reads a
+// width x height source and writes (width * factor) x (height * factor) pixels into a
+// caller-provided buffer. Pitches are row strides in bytes. With a pool, the source rows are
+// split into bands that are scaled on its workers.
+
+enum class ScaleFilter
+{
+    Nearest, // Integer pixel replication, any factor
+    Scale2x, // EPX / AdvMAME2x edge rules
+    Scale3x, // AdvMAME3x edge rules
+    HQ2x     // hq2x-style YUV edge blending (ARGB8888 only)
+};
+
+// Output size multiplier of a filter; Nearest uses the requested factor
+int scaleFactor(ScaleFilter filter, int nearestFactor);
+
+// Scale2x and Scale3x only compare pixels for equality, so they work on any pixel format,
+// including the PPU's palette indices before conversion
+template <typename Pixel>
+void scaleNearest(const Pixel *src, int srcPitch, int width, int height, int factor,
+                  Pixel *dst, int dstPitch, WorkerPool *pool = nullptr);
+
+template <typename Pixel>
+void scale2x(const Pixel *src, int srcPitch, int width, int height,
+             Pixel *dst, int dstPitch, WorkerPool *pool = nullptr);
+
+template <typename Pixel>
+void scale3x(const Pixel *src, int srcPitch, int width, int height,
+             Pixel *dst, int dstPitch, WorkerPool *pool = nullptr);
+
+void hq2x(const uint32_t *src, int srcPitch, int width, int height,
+          uint32_t *dst, int dstPitch, WorkerPool *pool = nullptr);
+
+// Run any filter on an ARGB8888 frame
+void scaleFrame(ScaleFilter filter, const uint32_t *src, int srcPitch, int width, int height,
+                int nearestFactor, uint32_t *dst, int dstPitch, WorkerPool *pool = nullptr);
+
+#endif // SCALER_H
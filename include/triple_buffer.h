@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for handing frames from one producer thread to one consumer thread.
+// The producer always has a buffer to write and the consumer always reads the newest
+// published one; neither side ever waits for the other. Frames the consumer misses are dropped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middle(1), backIndex(0), frontIndex(2) {}
+
+    // Producer: buffer to fill with the next frame
+    T &writeBuffer() { return buffers[backIndex]; }
+
+    // Producer: publish the write buffer and take over the previous middle buffer
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | NEW_FRAME, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer: switch to the newest published frame. Returns false if nothing new was published.
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & NEW_FRAME))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // Consumer: most recent frame taken by update()
+    const T &readBuffer() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t NEW_FRAME = 0x04; // Set while the middle buffer holds an unread frame
+
+    std::array<T, 3> buffers;
+    alignas(64) std::atomic<uint8_t> middle; // Index of the shared buffer, plus NEW_FRAME
+    alignas(64) uint8_t backIndex;           // Owned by the producer
+    alignas(64) uint8_t frontIndex;          // Owned by the consumer
+};
+
+#endif // TRIPLE_BUFFER_H
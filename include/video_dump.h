@@ -0,0 +1,54 @@
+#ifndef VIDEO_DUMP_H
+#define VIDEO_DUMP_H
+
+#include "async_writer.h"
+#include <array>
+#include <cstdint>
+#include <string>
+
+struct Frame;
+
+// Output formats of VideoDump
+enum class VideoFormat
+{
+    Y4M,    // YUV4MPEG2 stream, 4:2:0, readable by ffmpeg/x264 from a pipe
+    RawRGB, // Headerless 256x240 RGB24 frames
+    PNG     // One numbered PNG file per frame
+};
+
+// Streams emulated frames to disk or a pipe. Each frame is encoded on the calling thread into
+// a buffer from an AsyncFileWriter pool and written on its thread, so emulation only waits
+// if the output falls several frames behind.
+class VideoDump
+{
+public:
+    VideoDump();
+
+    // path is the output file, "-" for stdout; for PNG it is the name pattern, frame n being
+    // written as <path without .png>_<n, 6 digits>.png
+    bool open(const std::string &path, VideoFormat format);
+    void writeFrame(const Frame &frame);
+    void close();
+
+    bool isOpen() const { return opened; }
+    bool failed() const { return writer.failed(); }
+    unsigned long framesWritten() const { return frameCount; }
+
+    // Pick a format from a file name: .y4m, .rgb/.raw or .png (defaults to Y4M, e.g. for "-")
+    static VideoFormat formatForPath(const std::string &path);
+
+private:
+    void encodeY4M(const uint32_t *argb, AsyncFileWriter::Buffer &buffer);
+    void encodeRGB(const uint32_t *argb, AsyncFileWriter::Buffer &buffer);
+    void encodePNG(const uint32_t *argb, AsyncFileWriter::Buffer &buffer);
+
+    AsyncFileWriter writer;
+    VideoFormat format;
+    std::string pngPrefix;
+    bool opened;
+    bool headerWritten;
+    unsigned long frameCount;
+    std::array<uint32_t, 256 * 240> argb; // Palette conversion of the frame being encoded
+};
+
+#endif // VIDEO_DUMP_H
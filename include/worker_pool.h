@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split a range of rows into contiguous bands.
+// One job runs at a time: dispatch() starts it and returns, wait() blocks until it is done.
+class WorkerPool
+{
+public:
+    using Task = std::function<void(int begin, int end)>;
+
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void dispatch(int count, Task task);    // Run task over [0, count), one band per worker
+    void wait();                            // Block until the dispatched job has finished
+    void parallelFor(int count, Task task); // dispatch() followed by wait()
+
+private:
+    void workerLoop(int index);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+
+    Task task;
+    int count = 0;
+    unsigned generation = 0; // Incremented for every dispatched job
+    int pending = 0;         // Workers still running the current job
+    bool stopping = false;
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,748 @@
+#include "apu.h"
+#include "cpu.h"
+#include <algorithm> // For std::min, std::max
+#include <array>
+
+namespace
+{
+    // Output buffer: 100ms of samples may wait to be read before the oldest are dropped
+    const int BUFFER_MILLISECONDS = 100;
+
+    const uint8_t LENGTH_TABLE[32] = {
+        10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+        12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+    const uint8_t DUTY_TABLE[4][8] = {
+        {0, 1, 0, 0, 0, 0, 0, 0},  // 12.5%
+        {0, 1, 1, 0, 0, 0, 0, 0},  // 25%
+        {0, 1, 1, 1, 1, 0, 0, 0},  // 50%
+        {1, 0, 0, 1, 1, 1, 1, 1}}; // 25% negated
+
+    const uint8_t TRIANGLE_TABLE[32] = {
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+    // NTSC timer periods in CPU cycles
+    const uint16_t NOISE_PERIODS[16] = {
+        4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+    const uint16_t DMC_PERIODS[16] = {
+        428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+
+    // Frame counter steps, in CPU cycles from the start of the sequence. The 4-step sequence
+    // repeats after 29830 cycles, the 5-step one after 37282.
+    const int32_t FRAME_STEP_CYCLES[5] = {7457, 14913, 22371, 29829, 37281};
+    const int32_t FOUR_STEP_LENGTH = 29830;
+    const int32_t FIVE_STEP_LENGTH = 37282;
+
+    // Non-linear mixer of the 2A03 output stage, tabulated at compile time in output units:
+    // pulse_out = 95.88 / (8128 / (pulse1 + pulse2) + 100) and the usual approximation
+    // tnd_out = 163.67 / (24329 / (3 * triangle + 2 * noise + dmc) + 100)
+    constexpr std::array<int, 31> buildPulseTable()
+    {
+        std::array<int, 31> table{};
+        for (int i = 1; i < 31; ++i)
+        {
+            table[i] = static_cast<int>(95.88 / (8128.0 / i + 100.0) * APU::MIX_SCALE + 0.5);
+        }
+        return table;
+    }
+
+    constexpr std::array<int, 203> buildTndTable()
+    {
+        std::array<int, 203> table{};
+        for (int i = 1; i < 203; ++i)
+        {
+            table[i] = static_cast<int>(163.67 / (24329.0 / i + 100.0) * APU::MIX_SCALE + 0.5);
+        }
+        return table;
+    }
+
+    constexpr std::array<int, 31> PULSE_TABLE = buildPulseTable();
+    constexpr std::array<int, 203> TND_TABLE = buildTndTable();
+    static_assert(PULSE_TABLE[30] == 7238, "Pulse mix of two channels at full volume");
+    static_assert(TND_TABLE[202] == 20789, "Triangle, noise and DMC mix at full level");
+
+    // Number of timer clocks due before limit, for a timer next due at next (next < limit)
+    int32_t clocksBefore(int32_t next, int32_t limit, int32_t step)
+    {
+        return (limit - next + step - 1) / step;
+    }
+}
+
+APU::APU(int sampleRate)
+    : time(0), output(CPU_CLOCK_RATE, sampleRate, sampleRate * BUFFER_MILLISECONDS / 1000),
+      mutedChannels(0), tapsEnabled(false), tapLevels{}, cpu(nullptr)
+{
+    reset();
+}
+
+void APU::reset()
+{
+    time = currentCycle();
+    pulse1 = Pulse();
+    pulse2 = Pulse();
+    pulse2.twosComplementSweep = true;
+    triangle = Triangle();
+    noise = Noise();
+    dmc = DMC();
+    pulse1.nextClock = pulse2.nextClock = triangle.nextClock = noise.nextClock = dmc.nextClock = time;
+
+    fiveStepMode = false;
+    irqInhibit = false;
+    frameIrq = false;
+    frameStep = 0;
+    nextFrameStep = time + FRAME_STEP_CYCLES[0];
+    dmaCycle = NO_DMA;
+
+    mixLevel = 0;
+    output.clear();
+    for (int i = 0; i < CHANNEL_COUNT; ++i)
+    {
+        if (taps[i])
+            taps[i]->clear();
+        tapLevels[i] = 0;
+    }
+    updateIrq();
+}
+
+void APU::setCPU(CPU *cpuInstance)
+{
+    cpu = cpuInstance;
+}
+
+int32_t APU::currentCycle() const
+{
+    return cpu ? cpu->cycles : time;
+}
+
+void APU::catchUp()
+{
+    runUntil(currentCycle());
+}
+
+// A pending fetch, or else the output unit's clock that will empty the full sample buffer
+int32_t APU::nextDmaCycle() const
+{
+    if (dmaCycle != NO_DMA)
+        return dmaCycle;
+    if (dmc.bufferFull && dmc.bytesRemaining > 0)
+        return dmc.nextClock + (dmc.bitsRemaining - 1) * dmc.period;
+    return NO_DMA;
+}
+
+void APU::setChannelTap(Channel channel, bool enabled)
+{
+    int index = static_cast<int>(channel);
+    if (enabled == static_cast<bool>(taps[index]))
+        return;
+
+    runUntil(currentCycle());
+    if (enabled)
+    {
+        taps[index].reset(new BlipBuffer(CPU_CLOCK_RATE, output.getSampleRate(),
+                                         output.getSampleRate() * BUFFER_MILLISECONDS / 1000));
+        tapLevels[index] = 0;
+    }
+    else
+    {
+        taps[index].reset();
+    }
+
+    tapsEnabled = false;
+    for (const auto &tap : taps)
+    {
+        tapsEnabled = tapsEnabled || tap;
+    }
+    updateMix(time); // Start the tap at the channel's current level
+}
+
+int APU::channelSamplesAvailable(Channel channel) const
+{
+    const auto &tap = taps[static_cast<int>(channel)];
+    return tap ? tap->samplesAvailable() : 0;
+}
+
+int APU::readChannelSamples(Channel channel, int16_t *out, int count)
+{
+    const auto &tap = taps[static_cast<int>(channel)];
+    return tap ? tap->readSamples(out, count) : 0;
+}
+
+void APU::setChannelMuted(Channel channel, bool muted)
+{
+    runUntil(currentCycle());
+    uint8_t bit = 1 << static_cast<int>(channel);
+    mutedChannels = muted ? mutedChannels | bit : mutedChannels & ~bit;
+    updateMix(time);
+}
+
+// The frame interrupt is raised on the fourth step of the 4-step sequence
+int32_t APU::nextEventCycle() const
+{
+    int32_t next = nextDmaCycle();
+    if (!fiveStepMode && !irqInhibit && !frameIrq)
+        next = std::min(next, nextFrameStep + FRAME_STEP_CYCLES[3] - FRAME_STEP_CYCLES[frameStep]);
+    return next;
+}
+
+void APU::writeRegister(uint16_t address, uint8_t value)
+{
+    // Everything before this write plays with the old register values
+    runUntil(currentCycle());
+
+    switch (address)
+    {
+    case 0x4000:
+    case 0x4004:
+    {
+        Pulse &pulse = address == 0x4000 ? pulse1 : pulse2;
+        pulse.duty = value >> 6;
+        pulse.envelope.loop = value & 0x20;
+        pulse.envelope.constant = value & 0x10;
+        pulse.envelope.period = value & 0x0F;
+        pulse.updateOutput();
+        break;
+    }
+    case 0x4001:
+    case 0x4005:
+    {
+        Pulse &pulse = address == 0x4001 ? pulse1 : pulse2;
+        pulse.sweepEnabled = value & 0x80;
+        pulse.sweepPeriod = (value >> 4) & 0x07;
+        pulse.sweepNegate = value & 0x08;
+        pulse.sweepShift = value & 0x07;
+        pulse.sweepReload = true;
+        pulse.updateOutput();
+        break;
+    }
+    case 0x4002:
+    case 0x4006:
+    {
+        Pulse &pulse = address == 0x4002 ? pulse1 : pulse2;
+        pulse.period = (pulse.period & 0x0700) | value;
+        pulse.updateOutput();
+        break;
+    }
+    case 0x4003:
+    case 0x4007:
+    {
+        Pulse &pulse = address == 0x4003 ? pulse1 : pulse2;
+        pulse.period = (pulse.period & 0x00FF) | ((value & 0x07) << 8);
+        if (pulse.enabled)
+            pulse.length = LENGTH_TABLE[value >> 3];
+        pulse.phase = 0;
+        pulse.envelope.start = true;
+        pulse.updateOutput();
+        break;
+    }
+    case 0x4008:
+        triangle.control = value & 0x80;
+        triangle.linearPeriod = value & 0x7F;
+        break;
+    case 0x400A:
+        triangle.period = (triangle.period & 0x0700) | value;
+        break;
+    case 0x400B:
+        triangle.period = (triangle.period & 0x00FF) | ((value & 0x07) << 8);
+        if (triangle.enabled)
+            triangle.length = LENGTH_TABLE[value >> 3];
+        triangle.linearReload = true;
+        break;
+    case 0x400C:
+        noise.envelope.loop = value & 0x20;
+        noise.envelope.constant = value & 0x10;
+        noise.envelope.period = value & 0x0F;
+        noise.updateOutput();
+        break;
+    case 0x400E:
+        noise.shortMode = value & 0x80;
+        noise.period = NOISE_PERIODS[value & 0x0F];
+        break;
+    case 0x400F:
+        if (noise.enabled)
+            noise.length = LENGTH_TABLE[value >> 3];
+        noise.envelope.start = true;
+        noise.updateOutput();
+        break;
+    case 0x4010:
+        dmc.irqEnabled = value & 0x80;
+        if (!dmc.irqEnabled)
+            dmc.irq = false;
+        dmc.loop = value & 0x40;
+        dmc.period = DMC_PERIODS[value & 0x0F];
+        break;
+    case 0x4011:
+        dmc.output = value & 0x7F; // Direct load
+        break;
+    case 0x4012:
+        dmc.sampleAddress = 0xC000 | (value << 6);
+        break;
+    case 0x4013:
+        dmc.sampleLength = (value << 4) | 1;
+        break;
+    case 0x4015:
+        pulse1.enabled = value & 0x01;
+        pulse2.enabled = value & 0x02;
+        triangle.enabled = value & 0x04;
+        noise.enabled = value & 0x08;
+        if (!pulse1.enabled)
+            pulse1.length = 0;
+        if (!pulse2.enabled)
+            pulse2.length = 0;
+        if (!triangle.enabled)
+            triangle.length = 0;
+        if (!noise.enabled)
+            noise.length = 0;
+        pulse1.updateOutput();
+        pulse2.updateOutput();
+        noise.updateOutput();
+
+        dmc.irq = false;
+        if (!(value & 0x10))
+            dmc.bytesRemaining = 0;
+        else if (dmc.bytesRemaining == 0)
+            dmc.restart();
+        scheduleDma(time);
+        break;
+    case 0x4017:
+        // Writing restarts the sequence; the 5-step mode clocks the units immediately
+        fiveStepMode = value & 0x80;
+        irqInhibit = value & 0x40;
+        if (irqInhibit)
+            frameIrq = false;
+        frameStep = 0;
+        nextFrameStep = time + FRAME_STEP_CYCLES[0];
+        if (fiveStepMode)
+        {
+            quarterFrame();
+            halfFrame();
+        }
+        break;
+    default:
+        break;
+    }
+
+    updateMix(time);
+    updateIrq();
+}
+
+uint8_t APU::readStatus()
+{
+    runUntil(currentCycle());
+
+    uint8_t status = (pulse1.length > 0 ? 0x01 : 0) |
+                     (pulse2.length > 0 ? 0x02 : 0) |
+                     (triangle.length > 0 ? 0x04 : 0) |
+                     (noise.length > 0 ? 0x08 : 0) |
+                     (dmc.bytesRemaining > 0 ? 0x10 : 0) |
+                     (frameIrq ? 0x40 : 0) |
+                     (dmc.irq ? 0x80 : 0);
+    frameIrq = false; // Reading acknowledges the frame interrupt
+    updateIrq();
+    return status;
+}
+
+void APU::endFrame(int32_t frameCycles)
+{
+    runUntil(frameCycles);
+    output.endFrame(frameCycles);
+    if (tapsEnabled)
+    {
+        for (const auto &tap : taps)
+        {
+            if (tap)
+                tap->endFrame(frameCycles);
+        }
+    }
+
+    // Rebase every timestamp to the start of the next frame
+    time -= frameCycles;
+    nextFrameStep -= frameCycles;
+    if (dmaCycle != NO_DMA)
+        dmaCycle -= frameCycles;
+    pulse1.nextClock -= frameCycles;
+    pulse2.nextClock -= frameCycles;
+    triangle.nextClock -= frameCycles;
+    noise.nextClock -= frameCycles;
+    dmc.nextClock -= frameCycles;
+}
+
+// Advance every channel timer, DMC fetches and the frame counter to the given cycle, in time
+// order. A channel whose output cannot change before the next frame counter step skips its
+// timer clocks in one go.
+void APU::runUntil(int32_t cycle)
+{
+    while (time < cycle)
+    {
+        int32_t limit = std::min(cycle, nextFrameStep);
+
+        while (true)
+        {
+            int32_t next = limit;
+            int channel = -1;
+            if (pulse1.nextClock < next)
+            {
+                next = pulse1.nextClock;
+                channel = 0;
+            }
+            if (pulse2.nextClock < next)
+            {
+                next = pulse2.nextClock;
+                channel = 1;
+            }
+            if (triangle.nextClock < next)
+            {
+                next = triangle.nextClock;
+                channel = 2;
+            }
+            if (noise.nextClock < next)
+            {
+                next = noise.nextClock;
+                channel = 3;
+            }
+            if (dmc.nextClock < next)
+            {
+                next = dmc.nextClock;
+                channel = 4;
+            }
+            if (dmaCycle < next)
+            {
+                next = dmaCycle;
+                channel = 5;
+            }
+            if (channel < 0)
+                break;
+
+            switch (channel)
+            {
+            case 0:
+                pulse1.clockTimer(limit);
+                break;
+            case 1:
+                pulse2.clockTimer(limit);
+                break;
+            case 2:
+                triangle.clockTimer(limit);
+                break;
+            case 3:
+                noise.clockTimer(limit);
+                break;
+            case 4:
+                dmc.clockTimer(limit);
+                scheduleDma(next);
+                break;
+            default:
+                performDma();
+                break;
+            }
+            updateMix(next);
+        }
+
+        time = limit;
+        if (time == nextFrameStep)
+        {
+            clockFrameCounter();
+            updateMix(time);
+        }
+    }
+    updateIrq();
+}
+
+void APU::updateIrq()
+{
+    if (cpu)
+    {
+        cpu->setIrq(CPU::IRQ_APU_FRAME, frameIrq);
+        cpu->setIrq(CPU::IRQ_APU_DMC, dmc.irq);
+    }
+}
+
+void APU::clockFrameCounter()
+{
+    int steps = fiveStepMode ? 5 : 4;
+    int32_t sequenceLength = fiveStepMode ? FIVE_STEP_LENGTH : FOUR_STEP_LENGTH;
+
+    if (frameStep != 3 || !fiveStepMode) // The 5-step sequence idles on its fourth step
+        quarterFrame();
+    if (frameStep == 1 || frameStep == steps - 1)
+        halfFrame();
+    if (frameStep == 3 && !fiveStepMode && !irqInhibit)
+        frameIrq = true;
+
+    if (++frameStep == steps)
+    {
+        frameStep = 0;
+        nextFrameStep += sequenceLength - FRAME_STEP_CYCLES[steps - 1] + FRAME_STEP_CYCLES[0];
+    }
+    else
+    {
+        nextFrameStep += FRAME_STEP_CYCLES[frameStep] - FRAME_STEP_CYCLES[frameStep - 1];
+    }
+}
+
+// Envelopes and the triangle's linear counter
+void APU::quarterFrame()
+{
+    pulse1.envelope.clock();
+    pulse2.envelope.clock();
+    noise.envelope.clock();
+    triangle.clockLinearCounter();
+
+    pulse1.updateOutput();
+    pulse2.updateOutput();
+    noise.updateOutput();
+}
+
+// Length counters and sweep units
+void APU::halfFrame()
+{
+    if (!pulse1.envelope.loop && pulse1.length > 0)
+        --pulse1.length;
+    if (!pulse2.envelope.loop && pulse2.length > 0)
+        --pulse2.length;
+    if (!triangle.control && triangle.length > 0)
+        --triangle.length;
+    if (!noise.envelope.loop && noise.length > 0)
+        --noise.length;
+
+    pulse1.clockSweep();
+    pulse2.clockSweep();
+
+    pulse1.updateOutput();
+    pulse2.updateOutput();
+    noise.updateOutput();
+}
+
+// The memory reader fetches as soon as the sample buffer is empty
+void APU::scheduleDma(int32_t at)
+{
+    if (dmaCycle == NO_DMA && dmc.needsFetch())
+        dmaCycle = at;
+}
+
+// The CPU is halted while the DMC reads its sample byte
+void APU::performDma()
+{
+    int32_t fetchCycle = dmaCycle;
+    dmaCycle = NO_DMA;
+    if (!dmc.needsFetch())
+        return; // Playback was stopped after the fetch was scheduled
+
+    dmc.fetch(cpu);
+    if (cpu)
+        cpu->stallForDmc(fetchCycle);
+}
+
+// Mix the channel outputs; the change in level goes into the step buffer
+void APU::updateMix(int32_t at)
+{
+    if (tapsEnabled)
+        updateTaps(at);
+
+    int level;
+    if (!mutedChannels)
+    {
+        level = PULSE_TABLE[pulse1.output + pulse2.output] +
+                TND_TABLE[3 * triangle.output + 2 * noise.output + dmc.output];
+    }
+    else
+    {
+        auto unmuted = [this](Channel channel, int value) { return isChannelMuted(channel) ? 0 : value; };
+        level = PULSE_TABLE[unmuted(Channel::Pulse1, pulse1.output) + unmuted(Channel::Pulse2, pulse2.output)] +
+                TND_TABLE[3 * unmuted(Channel::Triangle, triangle.output) + 2 * unmuted(Channel::Noise, noise.output) +
+                          unmuted(Channel::DMC, dmc.output)];
+    }
+
+    if (level != mixLevel)
+    {
+        output.addDelta(at, level - mixLevel);
+        mixLevel = level;
+    }
+}
+
+// Each tap plays its channel as if it were the only one
+void APU::updateTaps(int32_t at)
+{
+    const int levels[CHANNEL_COUNT] = {PULSE_TABLE[pulse1.output], PULSE_TABLE[pulse2.output],
+                                       TND_TABLE[3 * triangle.output], TND_TABLE[2 * noise.output],
+                                       TND_TABLE[dmc.output]};
+    for (int i = 0; i < CHANNEL_COUNT; ++i)
+    {
+        if (taps[i] && levels[i] != tapLevels[i])
+        {
+            taps[i]->addDelta(at, levels[i] - tapLevels[i]);
+            tapLevels[i] = levels[i];
+        }
+    }
+}
+
+void APU::Envelope::clock()
+{
+    if (start)
+    {
+        start = false;
+        decay = 15;
+        divider = period;
+    }
+    else if (divider == 0)
+    {
+        divider = period;
+        if (decay > 0)
+            --decay;
+        else if (loop)
+            decay = 15;
+    }
+    else
+    {
+        --divider;
+    }
+}
+
+uint16_t APU::Pulse::sweepTarget() const
+{
+    int change = period >> sweepShift;
+    if (!sweepNegate)
+        return period + change;
+    return std::max(0, period - change - (twosComplementSweep ? 0 : 1));
+}
+
+void APU::Pulse::clockTimer(int32_t limit)
+{
+    int32_t step = 2 * (period + 1);
+    if (muted() || envelope.volume() == 0)
+    {
+        // Silent until a register write or frame counter step, neither of which comes before limit
+        int32_t clocks = clocksBefore(nextClock, limit, step);
+        phase = (phase + clocks) & 7;
+        nextClock += clocks * step;
+        return;
+    }
+
+    phase = (phase + 1) & 7;
+    nextClock += step;
+    updateOutput();
+}
+
+void APU::Pulse::clockSweep()
+{
+    if (sweepDivider == 0 && sweepEnabled && sweepShift > 0 && period >= 8 && sweepTarget() <= 0x7FF)
+        period = sweepTarget();
+
+    if (sweepDivider == 0 || sweepReload)
+    {
+        sweepDivider = sweepPeriod;
+        sweepReload = false;
+    }
+    else
+    {
+        --sweepDivider;
+    }
+}
+
+void APU::Pulse::updateOutput()
+{
+    output = (!muted() && DUTY_TABLE[duty][phase]) ? envelope.volume() : 0;
+}
+
+void APU::Triangle::clockTimer(int32_t limit)
+{
+    int32_t step = period + 1;
+    if (!stepping())
+    {
+        nextClock += clocksBefore(nextClock, limit, step) * step; // The level is held
+        return;
+    }
+
+    phase = (phase + 1) & 31;
+    nextClock += step;
+    output = TRIANGLE_TABLE[phase];
+}
+
+void APU::Triangle::clockLinearCounter()
+{
+    if (linearReload)
+        linearCounter = linearPeriod;
+    else if (linearCounter > 0)
+        --linearCounter;
+
+    if (!control)
+        linearReload = false;
+}
+
+void APU::Noise::clockTimer(int32_t limit)
+{
+    // While silent the shift register still runs, but nothing is heard until limit
+    int32_t clocks = (length == 0 || envelope.volume() == 0) ? clocksBefore(nextClock, limit, period) : 1;
+    int tap = shortMode ? 6 : 1;
+    for (int32_t i = 0; i < clocks; ++i)
+    {
+        uint16_t feedback = (shift ^ (shift >> tap)) & 1;
+        shift = (shift >> 1) | (feedback << 14);
+    }
+    nextClock += clocks * period;
+    updateOutput();
+}
+
+void APU::Noise::updateOutput()
+{
+    output = (length > 0 && !(shift & 1)) ? envelope.volume() : 0;
+}
+
+void APU::DMC::restart()
+{
+    currentAddress = sampleAddress;
+    bytesRemaining = sampleLength;
+}
+
+void APU::DMC::clockTimer(int32_t limit)
+{
+    if (silence && !bufferFull && bytesRemaining == 0)
+    {
+        // Idle: only the bit counter turns over until a $4015 write, which comes after limit
+        int32_t clocks = clocksBefore(nextClock, limit, period);
+        bitsRemaining = static_cast<uint8_t>(((bitsRemaining - 1 - clocks) % 8 + 8) % 8 + 1);
+        nextClock += clocks * period;
+        return;
+    }
+
+    if (!silence)
+    {
+        if (shiftRegister & 1)
+        {
+            if (output <= 125)
+                output += 2;
+        }
+        else if (output >= 2)
+        {
+            output -= 2;
+        }
+        shiftRegister >>= 1;
+    }
+
+    if (--bitsRemaining == 0)
+    {
+        bitsRemaining = 8;
+        silence = !bufferFull;
+        if (bufferFull)
+        {
+            shiftRegister = sampleBuffer;
+            bufferFull = false; // The APU schedules the next fetch
+        }
+    }
+    nextClock += period;
+}
+
+// Memory reader: load the next sample byte into the empty buffer
+void APU::DMC::fetch(CPU *cpu)
+{
+    sampleBuffer = cpu ? cpu->readMemory(currentAddress) : 0;
+    bufferFull = true;
+    currentAddress = currentAddress == 0xFFFF ? 0x8000 : currentAddress + 1;
+    if (--bytesRemaining == 0)
+    {
+        if (loop)
+            restart();
+        else if (irqEnabled)
+            irq = true;
+    }
+}
@@ -0,0 +1,141 @@
+#include "async_writer.h"
+#include <iostream>
+
+AsyncFileWriter::AsyncFileWriter(int bufferCount, size_t bufferCapacity) : buffers(bufferCount)
+{
+    for (Buffer &buffer : buffers)
+    {
+        buffer.data.resize(bufferCapacity);
+        freeBuffers.push_back(&buffer);
+    }
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    close();
+}
+
+bool AsyncFileWriter::open(const std::string &path)
+{
+    close();
+
+    if (path == "-")
+    {
+        file = stdout;
+        ownsFile = false;
+    }
+    else if (!path.empty())
+    {
+        file = fopen(path.c_str(), "wb");
+        ownsFile = true;
+        if (!file)
+        {
+            std::cerr << "Failed to open output file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    stopping = false;
+    error = false;
+    writer = std::thread(&AsyncFileWriter::writerLoop, this);
+    return true;
+}
+
+void AsyncFileWriter::close()
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_one();
+        writer.join();
+    }
+
+    if (file)
+    {
+        // A full disk often shows only when the last buffered bytes go out
+        bool ok = ownsFile ? fclose(file) == 0 : fflush(file) == 0;
+        file = nullptr;
+        if (!ok)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = true;
+        }
+    }
+}
+
+AsyncFileWriter::Buffer &AsyncFileWriter::acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (freeBuffers.empty())
+    {
+        ++stallCount;
+        released.wait(lock, [this]() { return !freeBuffers.empty(); });
+    }
+
+    Buffer *buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    buffer->size = 0;
+    buffer->path.clear();
+    return *buffer;
+}
+
+void AsyncFileWriter::submit(Buffer &buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(&buffer);
+    }
+    queued.notify_one();
+}
+
+bool AsyncFileWriter::failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+unsigned long AsyncFileWriter::stalls() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stallCount;
+}
+
+void AsyncFileWriter::writerLoop()
+{
+    while (true)
+    {
+        Buffer *buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return; // Stopping with nothing left to write
+            buffer = queue.front();
+            queue.pop_front();
+        }
+
+        // The file work happens without the lock so the producer can keep queueing
+        bool ok;
+        if (!buffer->path.empty())
+        {
+            FILE *out = fopen(buffer->path.c_str(), "wb");
+            ok = out && fwrite(buffer->data.data(), 1, buffer->size, out) == buffer->size;
+            if (out)
+                ok = fclose(out) == 0 && ok;
+        }
+        else
+        {
+            ok = file && fwrite(buffer->data.data(), 1, buffer->size, file) == buffer->size;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = error || !ok;
+            freeBuffers.push_back(buffer);
+        }
+        released.notify_one();
+    }
+}
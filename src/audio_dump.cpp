@@ -0,0 +1,166 @@
+#include "audio_dump.h"
+#include "frame_hash.h"
+#include <cstdio>
+#include <cstring> // For memcpy, strlen
+#include <iostream>
+
+namespace
+{
+    const int BUFFER_COUNT = 16;
+    const size_t BUFFER_CAPACITY = 64 * 1024; // About 0.75s of 44.1kHz mono per block
+    const size_t HEADER_SIZE = 44;
+    const uint32_t UNKNOWN_SIZE = 0xFFFFFFFF;
+
+    uint8_t *putLittleEndian16(uint8_t *p, uint16_t value)
+    {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+        return p + 2;
+    }
+
+    uint8_t *putLittleEndian32(uint8_t *p, uint32_t value)
+    {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+        p[2] = static_cast<uint8_t>(value >> 16);
+        p[3] = static_cast<uint8_t>(value >> 24);
+        return p + 4;
+    }
+
+    // Canonical 44-byte header of a mono 16-bit PCM WAVE file with dataSize bytes of samples
+    void wavHeader(uint8_t *p, int sampleRate, uint32_t dataSize)
+    {
+        uint32_t riffSize = dataSize == UNKNOWN_SIZE ? UNKNOWN_SIZE : dataSize + HEADER_SIZE - 8;
+        memcpy(p, "RIFF", 4);
+        p = putLittleEndian32(p + 4, riffSize);
+        memcpy(p, "WAVEfmt ", 8);
+        p = putLittleEndian32(p + 8, 16);                 // fmt chunk size
+        p = putLittleEndian16(p, 1);                      // PCM
+        p = putLittleEndian16(p, 1);                      // Mono
+        p = putLittleEndian32(p, sampleRate);
+        p = putLittleEndian32(p, sampleRate * 2);         // Bytes per second
+        p = putLittleEndian16(p, 2);                      // Bytes per sample frame
+        p = putLittleEndian16(p, 16);                     // Bits per sample
+        memcpy(p, "data", 4);
+        putLittleEndian32(p + 4, dataSize);
+    }
+}
+
+AudioDump::AudioDump()
+    : writer(BUFFER_COUNT, BUFFER_CAPACITY), block(nullptr), format(AudioFormat::WAV), sampleRate(0),
+      opened(false), error(false), sampleCount(0)
+{
+}
+
+AudioFormat AudioDump::formatForPath(const std::string &path)
+{
+    auto endsWith = [&path](const char *suffix)
+    {
+        size_t length = strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+
+    if (endsWith(".raw") || endsWith(".pcm"))
+        return AudioFormat::RawPCM;
+    return AudioFormat::WAV;
+}
+
+bool AudioDump::open(const std::string &outputPath, AudioFormat outputFormat, int outputSampleRate)
+{
+    close();
+    path = outputPath;
+    format = outputFormat;
+    sampleRate = outputSampleRate;
+    sampleCount = 0;
+    error = false;
+
+    opened = writer.open(path);
+    if (opened && format == AudioFormat::WAV)
+    {
+        block = &writer.acquire();
+        wavHeader(block->data.data(), sampleRate, UNKNOWN_SIZE);
+        block->size = HEADER_SIZE;
+    }
+    return opened;
+}
+
+void AudioDump::close()
+{
+    if (!opened)
+        return;
+
+    flush();
+    writer.close();
+    opened = false;
+    if (format == AudioFormat::WAV && path != "-")
+        finishHeader();
+}
+
+void AudioDump::writeSamples(const int16_t *samples, size_t count)
+{
+    if (!opened)
+        return;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!block)
+            block = &writer.acquire();
+        putLittleEndian16(&block->data[block->size], static_cast<uint16_t>(samples[i]));
+        block->size += 2;
+        if (block->size + 2 > BUFFER_CAPACITY)
+            flush();
+    }
+    sampleCount += count;
+}
+
+void AudioDump::flush()
+{
+    if (block)
+    {
+        writer.submit(*block);
+        block = nullptr;
+    }
+}
+
+// Rewrite the header of a finished file with the real sizes
+void AudioDump::finishHeader()
+{
+    FILE *file = fopen(path.c_str(), "r+b");
+    if (!file)
+    {
+        std::cerr << "Failed to update WAV header: " << path << std::endl;
+        error = true;
+        return;
+    }
+
+    uint8_t header[HEADER_SIZE];
+    wavHeader(header, sampleRate, static_cast<uint32_t>(sampleCount * 2));
+    error = fwrite(header, 1, HEADER_SIZE, file) != HEADER_SIZE || error;
+    error = fclose(file) != 0 || error;
+}
+
+AudioHash::AudioHash(int framesPerHash)
+    : framesPerHash(framesPerHash > 0 ? framesPerHash : 1), frameCount(0), runningHash(0), lastHash(0),
+      groupCount(0)
+{
+    frameSamples.reserve(2048);
+}
+
+void AudioHash::addSamples(const int16_t *samples, size_t count)
+{
+    frameSamples.insert(frameSamples.end(), samples, samples + count);
+}
+
+bool AudioHash::endFrame()
+{
+    runningHash = hash64(frameSamples.data(), frameSamples.size() * sizeof(int16_t), runningHash);
+    frameSamples.clear();
+    if (++frameCount < framesPerHash)
+        return false;
+
+    lastHash = runningHash;
+    runningHash = 0;
+    frameCount = 0;
+    ++groupCount;
+    return true;
+}
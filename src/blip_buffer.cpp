@@ -0,0 +1,127 @@
+#include "blip_buffer.h"
+#include <algorithm> // For std::min, std::max
+#include <array>
+#include <cmath>
+#include <cstring>   // For memmove
+
+namespace
+{
+    const int FRAC_BITS = 32;  // Fractional bits of sample positions
+    const int DELTA_BITS = 15; // log2(KERNEL_UNIT)
+    const int BASS_SHIFT = 9;  // High-pass of about 15 Hz that removes the DC offset of the mix
+
+    using Kernel = std::array<std::array<int32_t, BlipBuffer::KERNEL_TAPS>, BlipBuffer::PHASES>;
+
+    // Band-limited step kernel, stored as its derivative: a windowed-sinc impulse sampled at
+    // each sub-sample phase, in integers that sum to exactly KERNEL_UNIT so steps never leave
+    // a DC error behind
+    Kernel buildKernel()
+    {
+        const double pi = 3.14159265358979323846;
+        const double cutoff = 0.45; // Of the output sample rate
+        const int half = BlipBuffer::KERNEL_TAPS / 2;
+
+        Kernel kernel;
+        for (int phase = 0; phase < BlipBuffer::PHASES; ++phase)
+        {
+            double taps[BlipBuffer::KERNEL_TAPS];
+            double sum = 0.0;
+            for (int k = 0; k < BlipBuffer::KERNEL_TAPS; ++k)
+            {
+                // Distance of this output sample from the step, in samples
+                double x = k - half + 1 - static_cast<double>(phase) / BlipBuffer::PHASES;
+                double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * pi * cutoff * x) / (2.0 * pi * cutoff * x);
+                double u = x / half;
+                double window = 0.42 + 0.5 * std::cos(pi * u) + 0.08 * std::cos(2.0 * pi * u);
+                taps[k] = sinc * window;
+                sum += taps[k];
+            }
+
+            int32_t total = 0;
+            int largest = 0;
+            for (int k = 0; k < BlipBuffer::KERNEL_TAPS; ++k)
+            {
+                kernel[phase][k] = static_cast<int32_t>(std::lround(taps[k] / sum * BlipBuffer::KERNEL_UNIT));
+                total += kernel[phase][k];
+                if (kernel[phase][k] > kernel[phase][largest])
+                    largest = k;
+            }
+            kernel[phase][largest] += BlipBuffer::KERNEL_UNIT - total;
+        }
+        return kernel;
+    }
+
+    const Kernel &stepKernel()
+    {
+        static const Kernel kernel = buildKernel();
+        return kernel;
+    }
+}
+
+BlipBuffer::BlipBuffer(double clockRate, int sampleRate, int capacity)
+    : clockRate(clockRate), sampleRate(sampleRate), capacity(capacity),
+      factor(static_cast<uint64_t>(std::llround(sampleRate / clockRate * 4294967296.0))),
+      deltas(capacity * 2 + KERNEL_TAPS)
+{
+    stepKernel();
+    clear();
+}
+
+void BlipBuffer::clear()
+{
+    offset = 1ULL << (FRAC_BITS - PHASE_BITS - 1); // Round step times to the nearest phase
+    available = 0;
+    integrator = 0;
+    std::fill(deltas.begin(), deltas.end(), 0);
+}
+
+void BlipBuffer::addDelta(int32_t time, int delta)
+{
+    uint64_t position = offset + static_cast<uint64_t>(time) * factor;
+    size_t index = static_cast<size_t>(position >> FRAC_BITS);
+    if (index + KERNEL_TAPS > deltas.size())
+        return; // Far beyond the end of the frame; the caller forgot endFrame()
+
+    const int32_t *taps = stepKernel()[(position >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1)].data();
+    int32_t *out = &deltas[index];
+    for (int k = 0; k < KERNEL_TAPS; ++k)
+    {
+        out[k] += taps[k] * delta;
+    }
+}
+
+void BlipBuffer::endFrame(int32_t duration)
+{
+    offset += static_cast<uint64_t>(duration) * factor;
+    available = static_cast<int>(offset >> FRAC_BITS);
+
+    if (available > capacity)
+        readSamples(nullptr, available - capacity);
+}
+
+int BlipBuffer::readSamples(int16_t *out, int count)
+{
+    count = std::min(count, available);
+    int32_t sum = integrator;
+    for (int i = 0; i < count; ++i)
+    {
+        int32_t sample = sum + deltas[i];
+        int32_t level = sample >> DELTA_BITS;
+        sum = sample - (level << (DELTA_BITS - BASS_SHIFT));
+        if (out)
+            out[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, level)));
+    }
+    integrator = sum;
+    removeSamples(count);
+    return count;
+}
+
+void BlipBuffer::removeSamples(int count)
+{
+    // Keep the unread samples and the kernel tails that reach past them
+    size_t remaining = deltas.size() - count;
+    memmove(deltas.data(), deltas.data() + count, remaining * sizeof(int32_t));
+    std::fill(deltas.begin() + remaining, deltas.end(), 0);
+    available -= count;
+    offset -= static_cast<uint64_t>(count) << FRAC_BITS;
+}
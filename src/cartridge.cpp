@@ -0,0 +1,178 @@
+#include "cartridge.h"
+#include "cpu.h"
+#include "mapper.h"
+#include <climits>
+#include <cstring> // For memcmp
+#include <iostream>
+#include <utility>
+
+namespace
+{
+    const size_t HEADER_SIZE = 16;
+    const size_t TRAINER_SIZE = 512;
+    const size_t PRG_BANK_SIZE = 0x2000;
+    const size_t CHR_BANK_SIZE = 0x400;
+    const size_t CHR_RAM_SIZE = 0x2000;
+
+    // Wrap a bank number into [0, count); negative numbers count from the end
+    int wrapBank(int bank, int count)
+    {
+        bank %= count;
+        return bank < 0 ? bank + count : bank;
+    }
+}
+
+Cartridge::Cartridge()
+    : prgRom(nullptr), chrMemory(nullptr), prgRam{}, prgSize(0), chrSize(0), chrRam(false), fourScreen(false),
+      headerMirroring(Mirroring::Horizontal), mapperNumber(0), prgPages{}, cpu(nullptr), ppu(nullptr)
+{
+}
+
+Cartridge::~Cartridge() = default;
+
+bool Cartridge::load(const std::string &path)
+{
+    MappedFile newFile;
+    if (!newFile.open(path) || !parse(newFile.data(), newFile.size()))
+        return false;
+
+    // The banks now point into the mapping, which keeps its address when moved
+    file = std::move(newFile);
+    imageCopy.clear();
+    return true;
+}
+
+bool Cartridge::load(const uint8_t *image, size_t size)
+{
+    std::vector<uint8_t> copy(image, image + size);
+    if (!parse(copy.data(), copy.size()))
+        return false;
+
+    imageCopy = std::move(copy);
+    file.close();
+    return true;
+}
+
+bool Cartridge::parse(const uint8_t *image, size_t size)
+{
+    if (size < HEADER_SIZE || memcmp(image, "NES\x1A", 4) != 0)
+    {
+        std::cerr << "Invalid NES file" << std::endl;
+        return false;
+    }
+
+    // Decode into locals so a rejected image leaves the loaded cartridge untouched
+    const uint8_t flags6 = image[6];
+    const uint8_t flags7 = image[7];
+    const size_t newPrgSize = image[4] * 0x4000;
+    const size_t newChrSize = image[5] * 0x2000;
+    const int newMapperNumber = (flags6 >> 4) | (flags7 & 0xF0);
+
+    size_t offset = HEADER_SIZE + ((flags6 & 0x04) ? TRAINER_SIZE : 0);
+    if (newPrgSize == 0 || offset + newPrgSize + newChrSize > size)
+    {
+        std::cerr << "Truncated NES file: " << newPrgSize << " bytes PRG-ROM, " << newChrSize << " bytes CHR-ROM"
+                  << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<Mapper> newMapper = Mapper::create(newMapperNumber, *this);
+    if (!newMapper)
+    {
+        std::cerr << "Unsupported mapper: " << newMapperNumber << std::endl;
+        return false;
+    }
+
+    prgSize = newPrgSize;
+    chrSize = newChrSize;
+    mapperNumber = newMapperNumber;
+    fourScreen = flags6 & 0x08;
+    headerMirroring = (flags6 & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+    prgRom = image + offset;
+    chrRam = chrSize == 0;
+    if (chrRam)
+    {
+        chrRamData.assign(CHR_RAM_SIZE, 0);
+        chrMemory = chrRamData.data();
+    }
+    else
+    {
+        // The PPU only writes CHR pages when setChrWritable(true), which connect() leaves off
+        // for CHR-ROM, so the read-only mapping is never written through this pointer
+        chrRamData.clear();
+        chrMemory = const_cast<uint8_t *>(image + offset + prgSize);
+    }
+    prgRam.fill(0);
+    mapper = std::move(newMapper);
+
+    std::cout << "Mapper " << mapperNumber << ", PRG-ROM: " << prgSize << " bytes, "
+              << (chrRam ? "CHR-RAM" : "CHR-ROM") << ": " << (chrRam ? CHR_RAM_SIZE : chrSize) << " bytes" << std::endl;
+    return true;
+}
+
+void Cartridge::connect(CPU *cpuInstance, PPU *ppuInstance)
+{
+    cpu = cpuInstance;
+    ppu = ppuInstance;
+    if (ppu)
+    {
+        ppu->setChrWritable(chrRam);
+        ppu->setMirroring(fourScreen ? Mirroring::FourScreen : headerMirroring);
+    }
+    if (cpu)
+        cpu->setCartridge(this);
+    if (mapper)
+        mapper->reset();
+}
+
+void Cartridge::writeRegister(uint16_t address, uint8_t value)
+{
+    mapper->writeRegister(address, value);
+}
+
+int Cartridge::nextEventCycle() const
+{
+    return mapper ? mapper->nextIrqCycle() : INT_MAX;
+}
+
+void Cartridge::catchUp(int cycle)
+{
+    if (mapper)
+        mapper->catchUp(cycle);
+}
+
+void Cartridge::endFrame(int frameCycles)
+{
+    if (mapper)
+        mapper->endFrame(frameCycles);
+}
+
+void Cartridge::mapPrg(int slot, int bank)
+{
+    int count = static_cast<int>(prgSize / PRG_BANK_SIZE);
+    prgPages[slot] = prgRom + wrapBank(bank, count) * PRG_BANK_SIZE;
+}
+
+void Cartridge::mapChr(int slot, int bank)
+{
+    int count = static_cast<int>((chrRam ? CHR_RAM_SIZE : chrSize) / CHR_BANK_SIZE);
+    if (ppu)
+        ppu->setChrPage(slot, chrMemory + wrapBank(bank, count) * CHR_BANK_SIZE);
+}
+
+void Cartridge::setMirroring(Mirroring mode)
+{
+    if (ppu && !fourScreen)
+        ppu->setMirroring(mode);
+}
+
+void Cartridge::setIrq(bool active)
+{
+    if (cpu)
+        cpu->setIrq(CPU::IRQ_MAPPER, active);
+}
+
+bool Cartridge::renderingEnabled() const
+{
+    return ppu && (ppu->PPUMASK & 0x18);
+}
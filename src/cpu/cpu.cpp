@@ -1,10 +1,13 @@
 #include "cpu.h"
 #include "ppu.h"
+#include "apu.h"
+#include "cartridge.h"
+#include "mapped_file.h"
 #include "opcode_cycles.h"
 #include "cycle_exceptions.h"
 
+#include <algorithm>
 #include <iostream>
-#include <fstream>
 
 // Reset the CPU to its initial state
 void CPU::reset()
@@ -19,22 +22,21 @@ void CPU::reset()
     // Debugging log for verification
     std::cerr << "[CPU Debug] PC set to RESET vector: 0x" << std::hex << PC << std::endl;
     SP = 0xFF;
-    A = X = Y = P = 0;
+    A = X = Y = 0;
+    P = 1 << I; // Interrupts start disabled
+    irqPollDelayed = false;
     initializeOpcodeTable(); // Ensure opcode table is initialized
     cycles = 0;
 }
-// Load a ROM into memory starting at address 0x8000
+// Load a raw PRG image into memory starting at address 0x8000
 void CPU::loadROM(const std::string &filename)
 {
-    std::ifstream romFile(filename, std::ios::binary);
-    if (!romFile)
-    {
-        std::cerr << "Failed to open ROM file: " << filename << std::endl;
+    MappedFile romFile;
+    if (!romFile.open(filename))
         return;
-    }
 
-    // Load up to 32KB of ROM into memory at 0x8000
-    romFile.read(reinterpret_cast<char *>(&memory[0x8000]), 0x8000);
+    // Copy up to 32KB of ROM from the mapping into memory at 0x8000
+    std::copy_n(romFile.data(), std::min<size_t>(romFile.size(), 0x8000), &memory[0x8000]);
     std::cout << "ROM loaded successfully: " << filename << std::endl;
 }
 
@@ -157,10 +159,38 @@ void CPU::handleNMI()
               << cycles << std::endl;
 }
 
+// Drive the IRQ line for one source. The line stays asserted until every source releases it.
+void CPU::setIrq(uint8_t source, bool active)
+{
+    irqLine = active ? irqLine | source : irqLine & ~source;
+    if (irqLine && !getFlag(I))
+        nextEventCycle = runLimit = INT_MIN; // Poll after the current instruction
+}
+
+void CPU::handleIRQ()
+{
+    pushToStack((PC >> 8) & 0xFF);
+    pushToStack(PC & 0xFF);
+    pushToStack((P & ~0x10) | 0x20); // Break cleared, unused bit set
+    setFlag(I, true);
+    PC = readMemory(0xFFFE) | (readMemory(0xFFFF) << 8);
+    addCycles(7);
+}
+
+// CLI, SEI and PLP change the I flag after the interrupt poll of their last cycle, so the poll
+// that follows them still sees the old value: an IRQ waits one more instruction after CLI, and
+// one already pending is still taken right after SEI.
+void CPU::delayInterruptPoll(bool previousDisabled)
+{
+    irqPollDelayed = true;
+    irqPollDisabled = previousDisabled;
+    nextEventCycle = runLimit = INT_MIN;
+}
+
 void CPU::debugNMIVector()
 {
-    uint8_t vectorLow = memory[0xFFFA];
-    uint8_t vectorHigh = memory[0xFFFB];
+    uint8_t vectorLow = readMemory(0xFFFA);
+    uint8_t vectorHigh = readMemory(0xFFFB);
     std::cerr << "[Debug] NMI Vector: Low = 0x" << std::hex
               << static_cast<int>(vectorLow) << ", High = 0x"
               << static_cast<int>(vectorHigh)
@@ -182,6 +212,14 @@ uint8_t CPU::readMemory(uint16_t address)
         std::cerr << "[CPU Debug] Attempted PPU read with no linked PPU.\n";
         return 0; // Return 0 as a placeholder
     }
+    if (address == 0x4015 && apu)
+    {
+        return apu->readStatus();
+    }
+    if (cartridge && address >= 0x6000)
+    {
+        return address >= 0x8000 ? cartridge->readPrg(address) : cartridge->readPrgRam(address);
+    }
     // Return general memory value
     return memory[address];
 }
@@ -203,6 +241,11 @@ void CPU::writeMemory(uint16_t address, uint8_t value)
         if (ppu) // Ensure PPU is linked
         {
             ppu->writeDMA(value); // Trigger DMA transfer in the PPU
+
+            // The CPU is halted while 256 bytes are copied, plus an alignment cycle when the
+            // transfer starts on an odd cycle
+            cycles += 513 + ((cycles & 1) != static_cast<int>(oddFrameStart) ? 1 : 0);
+            oamDmaEnd = cycles;
         }
         else
         {
@@ -222,6 +265,14 @@ void CPU::writeMemory(uint16_t address, uint8_t value)
         if (ppu)
         {
             std::cerr << "[CPU Debug] Writing value to PPU.\n";
+            if (cartridge && ppuAddress == 0x2001)
+            {
+                // Mapper scanline counters only run while rendering is enabled
+                cartridge->catchUp(cycles);
+                ppu->writeRegister(ppuAddress, value);
+                refreshEventCycle();
+                return;
+            }
             ppu->writeRegister(ppuAddress, value);
             return; // Handled by PPU
         }
@@ -229,6 +280,28 @@ void CPU::writeMemory(uint16_t address, uint8_t value)
         return;
     }
 
+    if (apu && ((address >= 0x4000 && address <= 0x4013) || address == 0x4015 || address == 0x4017))
+    {
+        apu->writeRegister(address, value);
+        refreshEventCycle(); // The write may have started or stopped DMC playback or an interrupt
+        return;
+    }
+
+    if (cartridge && address >= 0x6000)
+    {
+        if (address >= 0x8000)
+        {
+            cartridge->catchUp(cycles);
+            cartridge->writeRegister(address, value);
+            refreshEventCycle(); // The mapper may have moved or acknowledged its interrupt
+        }
+        else
+        {
+            cartridge->writePrgRam(address, value);
+        }
+        return;
+    }
+
     // General memory write
     memory[address] = value;
 }
@@ -240,6 +313,16 @@ void CPU::setPPU(PPU *ppuInstance)
     ppu = ppuInstance;
 }
 
+void CPU::setAPU(APU *apuInstance)
+{
+    apu = apuInstance;
+}
+
+void CPU::setCartridge(Cartridge *cartridgeInstance)
+{
+    cartridge = cartridgeInstance;
+}
+
 std::function<void(CPU &)> withBaseCycles(uint8_t opcode, int baseCycles, std::function<void(CPU &)> handler)
 {
     return [opcode, baseCycles, handler](CPU &cpu)
@@ -324,6 +407,79 @@ void CPU::execute()
     }
 }
 
+// Run the instruction loop for a cycle budget. The last instruction may overshoot
+// targetCycle; callers carry the overshoot into the next budget. The inner loop compares only
+// against runLimit, which anything that brings an event forward lowers; at least one
+// instruction runs between two services, so an event that servicing leaves due cannot stall.
+void CPU::runUntil(int targetCycle)
+{
+    runTarget = targetCycle;
+    refreshEventCycle();
+    while (cycles < targetCycle)
+    {
+        do
+        {
+            execute();
+        } while (cycles < runLimit);
+
+        if (cycles >= nextEventCycle)
+            serviceEvents();
+    }
+    runTarget = INT_MAX;
+}
+
+void CPU::endFrame(int frameCycles)
+{
+    cycles -= frameCycles;
+    oamDmaEnd = oamDmaEnd > frameCycles ? oamDmaEnd - frameCycles : INT_MIN;
+    oddFrameStart ^= (frameCycles & 1) != 0;
+    if (cartridge)
+        cartridge->endFrame(frameCycles);
+}
+
+// Let the APU and the mapper catch up to this instruction, then poll the IRQ line. DMC fetches
+// the APU makes on the way stall the CPU, and interrupts are asserted before the poll.
+void CPU::serviceEvents()
+{
+    if (apu)
+        apu->catchUp();
+    if (cartridge)
+        cartridge->catchUp(cycles);
+
+    bool disabled = irqPollDelayed ? irqPollDisabled : getFlag(I);
+    irqPollDelayed = false;
+    if (irqLine && !disabled)
+        handleIRQ();
+    refreshEventCycle();
+}
+
+void CPU::refreshEventCycle()
+{
+    if (irqPollDelayed || (irqLine && !getFlag(I)))
+        nextEventCycle = INT_MIN;
+    else
+    {
+        nextEventCycle = apu ? apu->nextEventCycle() : INT_MAX;
+        if (cartridge)
+            nextEventCycle = std::min(nextEventCycle, cartridge->nextEventCycle());
+    }
+    runLimit = std::min(runTarget, nextEventCycle);
+}
+
+// A DMC fetch takes 4 cycles: halt, a dummy cycle, alignment and the read. During OAM DMA it
+// steals only 2, as the halt and alignment overlap the transfer, and the transfer ends later.
+void CPU::stallForDmc(int fetchCycle)
+{
+    if (fetchCycle < oamDmaEnd)
+    {
+        cycles += 2;
+        oamDmaEnd += 2;
+    }
+    else
+    {
+        cycles += 4;
+    }
+}
 
 // Initialize the opcode table
 void CPU::initializeOpcodeTable()
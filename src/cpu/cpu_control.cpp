@@ -51,6 +51,7 @@ void CPU::performRTI()
 
     // Combine the bytes to form the full PC
     PC = static_cast<uint16_t>(pch) << 8 | pcl;
+    refreshEventCycle(); // The restored I flag applies to the next poll
 
     // Debug output for verification
     // std::cout << "RTI: Restored PC = " << std::hex << PC
@@ -231,6 +232,10 @@ void initializeControlOpcodes(std::unordered_map<uint8_t, std::function<void(CPU
         cpu.PC = (pch << 8) | pcl;
        // std::cerr << "[RTI Debug] Restored PC: " << std::hex << cpu.PC << "\n";
 
+        // Unlike CLI and PLP, RTI restores the I flag before the poll: a still active IRQ
+        // is taken again right away
+        cpu.refreshEventCycle();
+
        // std::cerr << "[RTI Debug] Final Stack State:\n";
         cpu.debugStack();
     };
@@ -194,6 +194,12 @@ const std::unordered_map<uint8_t, int> opcodeCycles = {
     {0xE1, 6}, // (Indirect,X)
     {0xF1, 5}, // (Indirect),Y
 
+    // CLC, CLD, CLI, CLV - Clear Flags
+    {0x18, 2}, // Implied
+    {0xD8, 2}, // Implied
+    {0x58, 2}, // Implied
+    {0xB8, 2}, // Implied
+
     // SEC - Set Carry
     {0x38, 2}, // Implied
 
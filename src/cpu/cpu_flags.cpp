@@ -29,6 +29,7 @@ void initializeFlagsOpcodes(std::unordered_map<uint8_t, std::function<void(CPU &
     opcodeTable[0x58] = [](CPU &cpu)
     {
        // std::cout << "Executing CLI: Clearing Interrupt Disable Flag (I)" << std::endl;
+        cpu.delayInterruptPoll(cpu.getFlag(CPU::I));
         cpu.P &= ~(1 << 2); // Clear the Interrupt Disable flag (bit 2 of P)
     };
 #pragma endregion
@@ -38,6 +39,7 @@ void initializeFlagsOpcodes(std::unordered_map<uint8_t, std::function<void(CPU &
 
     opcodeTable[0x78] = [](CPU &cpu) { // SEI - Set Interrupt Disable
        // std::cout << "Executing SEI: Setting Interrupt Disable Flag (I)" << std::endl;
+        cpu.delayInterruptPoll(cpu.getFlag(CPU::I));
         cpu.setFlag(CPU::I, true); // Set the Interrupt Disable flag (I) to 1
     };
 
@@ -59,6 +59,7 @@ void initializeStackOpcodes(std::unordered_map<uint8_t, std::function<void(CPU &
         uint8_t flags = cpu.readMemory(0x0100 + cpu.SP);
 
         // Load the pulled value into the status register (excluding B flag)
+        cpu.delayInterruptPoll(cpu.getFlag(CPU::I));
         cpu.P = flags & 0xEF; // Mask out the B flag (bit 4)
 
         // Debug output
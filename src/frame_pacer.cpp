@@ -0,0 +1,149 @@
+#include "frame_pacer.h"
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+FramePacer::FramePacer(double frameRate)
+    : source(SyncSource::WallClock),
+      period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRate))),
+      spinThreshold(std::chrono::microseconds(1500)),
+      started(false),
+      audioTarget(0.0),
+      vsyncCount(0),
+      vsyncSeen(0)
+{
+    histogram.fill(0);
+}
+
+void FramePacer::setSyncSource(SyncSource newSource)
+{
+    source = newSource;
+    reset();
+}
+
+void FramePacer::setAudioQueue(std::function<double()> queuedSeconds, double targetSeconds)
+{
+    audioQueued = std::move(queuedSeconds);
+    audioTarget = targetSeconds;
+}
+
+void FramePacer::reset()
+{
+    started = false;
+}
+
+void FramePacer::waitForNextFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (!started)
+    {
+        started = true;
+        deadline = now + period;
+        lastFrame = now;
+        return;
+    }
+
+    switch (source)
+    {
+    case SyncSource::WallClock:
+        // Fixed deadlines, so sleep overshoot does not accumulate. After a long stall (a
+        // debugger, a dragged window) start over instead of running fast to catch up.
+        if (now > deadline + period * 4)
+            deadline = now;
+        waitUntil(deadline);
+        deadline += period;
+        break;
+
+    case SyncSource::Vsync:
+    {
+        std::unique_lock<std::mutex> lock(vsyncMutex);
+        vsyncSignal.wait(lock, [this]() { return vsyncCount != vsyncSeen; });
+        vsyncSeen = vsyncCount;
+        break;
+    }
+
+    case SyncSource::AudioQueue:
+        // The audio device drains the queue in real time; hold frames while it is full enough.
+        // Without a queue this behaves like the wall clock.
+        if (!audioQueued)
+        {
+            waitUntil(deadline);
+            deadline += period;
+            break;
+        }
+        while (audioQueued() > audioTarget)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        break;
+    }
+
+    recordInterval(Clock::now());
+}
+
+void FramePacer::signalVsync()
+{
+    {
+        std::lock_guard<std::mutex> lock(vsyncMutex);
+        ++vsyncCount;
+    }
+    vsyncSignal.notify_one();
+}
+
+void FramePacer::waitUntil(Clock::time_point target)
+{
+    while (true)
+    {
+        Clock::time_point now = Clock::now();
+        if (now >= target)
+            return;
+        if (target - now > spinThreshold)
+            std::this_thread::sleep_for(target - now - spinThreshold);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void FramePacer::recordInterval(Clock::time_point now)
+{
+    double deviationMs = std::chrono::duration<double, std::milli>(now - lastFrame - period).count();
+    lastFrame = now;
+
+    int bucket = static_cast<int>(std::lround(deviationMs / JITTER_BUCKET_MS)) + JITTER_BUCKETS / 2;
+    if (bucket < 0)
+        bucket = 0;
+    if (bucket >= JITTER_BUCKETS)
+        bucket = JITTER_BUCKETS - 1;
+    ++histogram[bucket];
+}
+
+std::string FramePacer::formatJitterHistogram() const
+{
+    uint32_t total = 0;
+    uint32_t largest = 0;
+    for (uint32_t count : histogram)
+    {
+        total += count;
+        largest = count > largest ? count : largest;
+    }
+
+    std::string text = "Frame time jitter (deviation from the frame period):\n";
+    if (total == 0)
+        return text;
+
+    char line[96];
+    for (int i = 0; i < JITTER_BUCKETS; ++i)
+    {
+        if (histogram[i] == 0)
+            continue;
+        double deviation = (i - JITTER_BUCKETS / 2) * JITTER_BUCKET_MS;
+        const char *edge = i == 0 ? "<=" : (i == JITTER_BUCKETS - 1 ? ">=" : "  ");
+        int bar = static_cast<int>(40.0 * histogram[i] / largest);
+        snprintf(line, sizeof(line), "%s%+5.1fms %7u %5.1f%% ", edge, deviation, histogram[i],
+                 100.0 * histogram[i] / total);
+        text += line;
+        text.append(bar, '#');
+        text += '\n';
+    }
+    return text;
+}
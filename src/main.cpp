@@ -1,93 +1,38 @@
 #include <iostream>
-#include <fstream>
+#include <string>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "cpu.h"
+#include "cartridge.h"
 #include "controller.h"
 #include <SDL2/SDL.h>
 #include "ppu.h"
+#include "apu.h"
+#include "audio_dump.h"
+#include "palette.h"
+#include "triple_buffer.h"
+#include "audio_ring.h"
+#include "resampler.h"
+#include "dirty_rows.h"
+#include "frame_pacer.h"
+#include "video_dump.h"
 
 const int SCREEN_WIDTH = 256;      // NES screen width
 const int SCREEN_HEIGHT = 240;     // NES screen height
-const int FRAME_DELAY = 1000 / 60; // ~60 FPS delay
 
-void loadROM(CPU &cpu, PPU &ppu, const std::string &filepath)
+void loadROM(Cartridge &cartridge, CPU &cpu, PPU &ppu, const std::string &filepath)
 {
-    std::ifstream rom(filepath, std::ios::binary);
-    if (!rom.is_open())
+    if (!cartridge.load(filepath))
     {
-        std::cerr << "Failed to open ROM: " << filepath << std::endl;
+        std::cerr << "Failed to load ROM: " << filepath << std::endl;
         exit(1);
     }
 
-    // Read the NES header
-    char header[16];
-    rom.read(header, 16);
-
-    // Verify that it's a valid NES file
-    if (header[0] != 'N' || header[1] != 'E' || header[2] != 'S' || header[3] != 0x1A)
-    {
-        std::cerr << "Invalid NES file: " << filepath << std::endl;
-        exit(1);
-    }
-
-    // Get PRG-ROM size (in 16KB units)
-    int prgSize = header[4] * 16384; // PRG-ROM size in bytes
-    if (prgSize > 0x8000)
-    {
-        std::cerr << "PRG-ROM size exceeds memory limit!" << std::endl;
-        exit(1);
-    }
-
-    // Load PRG-ROM into memory at 0x8000
-    rom.read(reinterpret_cast<char *>(&cpu.memory[0x8000]), prgSize);
-
-    if (!rom)
-    {
-        std::cerr << "Error reading PRG-ROM" << std::endl;
-        exit(1);
-    }
-
-    // Mirror PRG-ROM for smaller sizes
-    if (prgSize == 0x4000)
-    {
-        for (size_t i = 0; i < 0x4000; ++i)
-        {
-            cpu.writeMemory(0xC000 + i, cpu.readMemory(0x8000 + i));
-        }
-    }
-
-    // Load CHR-ROM into PPU memory (if available)
-    int chrSize = header[5] * 8192; // CHR-ROM size in 8KB units
-    if (chrSize > 0)
-    {
-        rom.read(reinterpret_cast<char *>(&ppu.memory[0x0000]), chrSize);
-        if (!rom)
-        {
-            std::cerr << "Error reading CHR-ROM" << std::endl;
-            exit(1);
-        }
-    }
-    else
-    {
-        // Handle CHR-RAM if no CHR-ROM is present
-        std::cerr << "[Debug] CHR-ROM size is 0. Assuming CHR-RAM." << std::endl;
-        std::fill(ppu.memory.begin(), ppu.memory.begin() + 0x2000, 0); // Initialize 8KB CHR-RAM
-    }
-
-    // Calculate offset for the last 6 bytes of PRG-ROM
-    int vectorOffset = 16 + prgSize - 6; // 16 bytes for header
-    rom.seekg(vectorOffset, std::ios::beg);
-
-    // Read the interrupt vectors
-    uint8_t vectorBytes[6];
-    rom.read(reinterpret_cast<char *>(vectorBytes), 6);
-
-    // Assign the vectors to the correct memory locations
-    cpu.writeMemory(0xFFFA, vectorBytes[0]); // NMI Vector Low
-    cpu.writeMemory(0xFFFB, vectorBytes[1]); // NMI Vector High
-    cpu.writeMemory(0xFFFC, vectorBytes[2]); // RESET Vector Low
-    cpu.writeMemory(0xFFFD, vectorBytes[3]); // RESET Vector High
-    cpu.writeMemory(0xFFFE, vectorBytes[4]); // IRQ/BRK Vector Low
-    cpu.writeMemory(0xFFFF, vectorBytes[5]); // IRQ/BRK Vector High
+    // Map the PRG and CHR banks, and mirroring from the header or the mapper
+    cartridge.connect(&cpu, &ppu);
 
     // Fetch vectors for debugging
     uint16_t nmiVector = (cpu.readMemory(0xFFFB) << 8) | cpu.readMemory(0xFFFA);
@@ -100,20 +45,26 @@ void loadROM(CPU &cpu, PPU &ppu, const std::string &filepath)
     std::cout << "[Debug] Fetched IRQ/BRK vector: 0x" << std::hex << irqVector << std::endl;
 
     std::cout << "ROM loaded successfully: " << filepath << std::endl;
-    std::cout << "PRG-ROM size: " << prgSize << " bytes" << std::endl;
-
-    rom.close();
-
-    // Dump NMI vector for further debugging
-    cpu.debugNMIVector();
-    //ppu.debugPatternTable();
 }
 
 
-void displayFramebuffer(SDL_Renderer *renderer, SDL_Texture *texture, const PPU &ppu)
+void displayFramebuffer(SDL_Renderer *renderer, SDL_Texture *texture, const Frame &frame, DirtyRowTracker &dirtyRows)
 {
-    // Update the texture with the framebuffer data
-    SDL_UpdateTexture(texture, nullptr, ppu.framebuffer.data(), SCREEN_WIDTH * sizeof(uint32_t));
+    // Convert only the scanlines that changed since the last presented frame, straight into
+    // the streaming texture; locking a row range uploads just that range
+    dirtyRows.update(frame);
+    dirtyRows.forEachDirtyRange([&](int begin, int end)
+    {
+        SDL_Rect rows = {0, begin, SCREEN_WIDTH, end - begin};
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(texture, &rows, &pixels, &pitch) == 0)
+        {
+            convertFrame(frame.pixels.data() + begin * SCREEN_WIDTH, frame.emphasis.data() + begin,
+                         SCREEN_WIDTH, end - begin, PixelFormat::ARGB8888, pixels, pitch);
+            SDL_UnlockTexture(texture);
+        }
+    });
 
     // Clear and present the renderer
     SDL_RenderClear(renderer);
@@ -121,6 +72,32 @@ void displayFramebuffer(SDL_Renderer *renderer, SDL_Texture *texture, const PPU
     SDL_RenderPresent(renderer);
 }
 
+// PPU viewer window (F2): the nametables on the left; pattern tables, palettes and sprites
+// stacked on the right
+const int VIEWER_WIDTH = PPU::NAMETABLE_VIEW_WIDTH + PPU::PATTERN_VIEW_WIDTH;
+const int VIEWER_HEIGHT = PPU::NAMETABLE_VIEW_HEIGHT;
+using ViewerImage = std::array<uint32_t, VIEWER_WIDTH * VIEWER_HEIGHT>;
+
+void renderViewer(const PPU &ppu, ViewerImage &image)
+{
+    const int pitch = VIEWER_WIDTH * 4;
+    image.fill(0xFF000000);
+
+    ppu.viewNametables(image.data(), pitch);
+    uint32_t *right = image.data() + PPU::NAMETABLE_VIEW_WIDTH;
+    ppu.viewPatternTables(right, pitch, 0);
+    right += PPU::PATTERN_VIEW_HEIGHT * VIEWER_WIDTH;
+    ppu.viewPalettes(right, pitch);
+    right += (PPU::PALETTE_VIEW_HEIGHT + 8) * VIEWER_WIDTH;
+    ppu.viewSprites(right, pitch);
+}
+
+// SDL audio callback: drain the ring the emulation thread fills. Runs on SDL's audio thread.
+void audioCallback(void *userdata, Uint8 *stream, int len)
+{
+    static_cast<AudioRing *>(userdata)->pop(reinterpret_cast<int16_t *>(stream), len / sizeof(int16_t));
+}
+
 void debugCPU(const CPU &cpu)
 {
     // Print out CPU state
@@ -134,18 +111,259 @@ void debugCPU(const CPU &cpu)
               << std::endl;
 }
 
-int main()
+// Run one frame of CPU time, then hand the frame to the renderer and raise VBlank/NMI. A frame
+// starts at VBlank. Returns true with the previous frame, which the render workers drew while
+// the CPU ran this one, copied into frame. The frame's audio is left in the APU's buffer.
+bool emulateFrame(CPU &cpu, PPU &ppu, APU &apu, bool &frameRendered, Frame &frame)
 {
+    cpu.runUntil(PPU::CPU_CYCLES_PER_FRAME);
+    apu.endFrame(PPU::CPU_CYCLES_PER_FRAME);
+    cpu.endFrame(PPU::CPU_CYCLES_PER_FRAME);
+
+    bool copied = frameRendered;
+    if (copied)
+    {
+        ppu.copyFrame(frame);
+    }
+    ppu.renderFrame();
+    frameRendered = true;
+    return copied;
+}
+
+// Take the samples of the frame just emulated from the APU into block and pass them to the
+// audio dump and hash. They are at the APU's nominal rate, so the dump and the hashes are the
+// same whether emulation ran paced, headless or fast. Returns the number of samples.
+int readFrameAudio(APU &apu, std::vector<int16_t> &block, AudioDump &audioDump, AudioHash *audioHash)
+{
+    int count = apu.readSamples(block.data(), static_cast<int>(block.size()));
+    audioDump.writeSamples(block.data(), count);
+    if (audioHash)
+    {
+        audioHash->addSamples(block.data(), count);
+        if (audioHash->endFrame())
+        {
+            std::cerr << "Audio hash " << std::dec << audioHash->groups() << ": 0x" << std::hex
+                      << audioHash->value() << std::dec << std::endl;
+        }
+    }
+    return count;
+}
+
+// Print the hash of every framesPerHash-th frame, numbered from 1, for golden-value comparisons
+void reportFrameHash(const Frame &frame, long frameNumber, int framesPerHash)
+{
+    if (framesPerHash > 0 && frameNumber % framesPerHash == 0)
+    {
+        std::cerr << "Frame hash " << std::dec << frameNumber << ": 0x" << std::hex << frame.hash << std::dec
+                  << std::endl;
+    }
+}
+
+// Run without a window as fast as possible, e.g. to dump video or check frame hashes. Every
+// emulated frame is written, the last one after waiting for its render. Stops at the first
+// frame a dump could not write; returns non-zero if the video dump failed.
+int runHeadless(CPU &cpu, PPU &ppu, APU &apu, VideoDump &videoDump, AudioDump &audioDump, AudioHash *audioHash,
+                int frameHashFrames, long frameLimit)
+{
+    std::vector<int16_t> audioBlock(apu.getSampleRate() / 30); // Two frames of samples
+    Frame frame = {};
+    bool frameRendered = false;
+    long frameCount = 0;
+    long framesDrawn = 0; // Trails frameCount by the frame still rendering
+
+    while (frameLimit == 0 || frameCount < frameLimit)
+    {
+        cpu.writeMemory(0x4016, 0);
+        if (emulateFrame(cpu, ppu, apu, frameRendered, frame))
+        {
+            videoDump.writeFrame(frame);
+            reportFrameHash(frame, ++framesDrawn, frameHashFrames);
+        }
+        readFrameAudio(apu, audioBlock, audioDump, audioHash);
+        ++frameCount;
+        if (videoDump.failed() || audioDump.failed())
+            break;
+    }
+
+    if (frameRendered)
+    {
+        ppu.copyFrame(frame); // Waits for the frame still in flight
+        if (!videoDump.failed())
+            videoDump.writeFrame(frame);
+        reportFrameHash(frame, ++framesDrawn, frameHashFrames);
+    }
+
+    std::cerr << "Emulated " << std::dec << frameCount << " frames, last frame hash: 0x"
+              << std::hex << frame.hash << std::dec << std::endl;
+
+    videoDump.close();
+    if (videoDump.failed())
+    {
+        std::cerr << "Failed to write the video dump, the output is incomplete" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] [rom]\n"
+              << "  --dump-video <path>     Write every frame to a file, - for stdout\n"
+              << "  --video-format <fmt>    y4m, rgb or png (default: from the file name, y4m for -)\n"
+              << "  --dump-audio <path>     Write the APU output to a file, - for stdout\n"
+              << "  --audio-format <fmt>    wav or raw (default: from the file name, wav for -)\n"
+              << "  --audio-hash <n>        Print a hash of the audio of every n frames\n"
+              << "  --frame-hash <n>        Print the hash of every n-th frame\n"
+              << "  --headless              Run without a window, as fast as possible\n"
+              << "  --frames <n>            Stop after n frames\n"
+              << "  --sync <source>         Frame pacing: wall (default), vsync or audio\n"
+              << "  --audio-latency <ms>    Audio queued ahead of the device (default: 40)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // Command line
+    std::string romPath = "roms/hello_world.nes";
+    std::string dumpVideoPath;
+    std::string videoFormatName;
+    std::string dumpAudioPath;
+    std::string audioFormatName;
+    int audioHashFrames = 0; // 0 disables audio hashes
+    int frameHashFrames = 0; // 0 disables per-frame hashes
+    bool headless = false;
+    long frameLimit = 0; // 0 runs until the window is closed
+    SyncSource syncSource = SyncSource::WallClock;
+    double audioLatency = 0.04; // Seconds of audio kept queued ahead of the device
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--dump-video" && i + 1 < argc)
+            dumpVideoPath = argv[++i];
+        else if (arg == "--video-format" && i + 1 < argc)
+            videoFormatName = argv[++i];
+        else if (arg == "--dump-audio" && i + 1 < argc)
+            dumpAudioPath = argv[++i];
+        else if (arg == "--audio-format" && i + 1 < argc)
+            audioFormatName = argv[++i];
+        else if (arg == "--audio-hash" && i + 1 < argc)
+            audioHashFrames = std::stoi(argv[++i]);
+        else if (arg == "--frame-hash" && i + 1 < argc)
+            frameHashFrames = std::stoi(argv[++i]);
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--frames" && i + 1 < argc)
+            frameLimit = std::stol(argv[++i]);
+        else if (arg == "--audio-latency" && i + 1 < argc)
+            audioLatency = std::stod(argv[++i]) / 1000.0;
+        else if (arg == "--sync" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            if (name == "wall")
+                syncSource = SyncSource::WallClock;
+            else if (name == "vsync")
+                syncSource = SyncSource::Vsync;
+            else if (name == "audio")
+                syncSource = SyncSource::AudioQueue;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+            romPath = arg;
+    }
+
+    // Video or audio on stdout: move all text logging to stderr so it cannot corrupt the stream
+    if (dumpVideoPath == "-" && dumpAudioPath == "-")
+    {
+        std::cerr << "Video and audio cannot both be written to stdout" << std::endl;
+        return 1;
+    }
+    if (dumpVideoPath == "-" || dumpAudioPath == "-")
+    {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    VideoDump videoDump;
+    if (!dumpVideoPath.empty())
+    {
+        VideoFormat format = VideoDump::formatForPath(dumpVideoPath);
+        if (videoFormatName == "y4m")
+            format = VideoFormat::Y4M;
+        else if (videoFormatName == "rgb")
+            format = VideoFormat::RawRGB;
+        else if (videoFormatName == "png")
+            format = VideoFormat::PNG;
+        else if (!videoFormatName.empty())
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if (!videoDump.open(dumpVideoPath, format))
+            return 1;
+    }
+
+    Cartridge cartridge;
     CPU cpu;
     Controller controller;
     PPU ppu;
+    APU apu;
+
+    AudioDump audioDump;
+    if (!dumpAudioPath.empty())
+    {
+        AudioFormat format = AudioDump::formatForPath(dumpAudioPath);
+        if (audioFormatName == "wav")
+            format = AudioFormat::WAV;
+        else if (audioFormatName == "raw")
+            format = AudioFormat::RawPCM;
+        else if (!audioFormatName.empty())
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if (!audioDump.open(dumpAudioPath, format, apu.getSampleRate()))
+            return 1;
+    }
+    std::unique_ptr<AudioHash> audioHash(audioHashFrames > 0 ? new AudioHash(audioHashFrames) : nullptr);
 
-    // Link the PPU to the CPU
+    // Link the PPU and APU to the CPU
     cpu.setPPU(&ppu);
     ppu.setCPU(&cpu);
+    cpu.setAPU(&apu);
+    apu.setCPU(&cpu);
+
+    // Draw frames on worker threads while the CPU runs ahead
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    ppu.setRenderThreads(hardwareThreads > 2 ? std::min(hardwareThreads - 2, 4u) : 0);
+
+    if (headless)
+    {
+        loadROM(cartridge, cpu, ppu, romPath);
+        cpu.reset();
+        ppu.reset();
+        apu.reset();
+        int result = runHeadless(cpu, ppu, apu, videoDump, audioDump, audioHash.get(), frameHashFrames, frameLimit);
+        audioDump.close(); // Also rewrites the WAV header with the final sizes
+        if (audioDump.failed())
+        {
+            std::cerr << "Failed to write the audio dump, the output is incomplete" << std::endl;
+            result = 1;
+        }
+        return result;
+    }
 
     // SDL Initialization with error checking
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
         std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
         return 1;
@@ -164,7 +382,7 @@ int main()
         return 1;
     }
 
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer)
     {
         std::cerr << "Failed to create SDL renderer: " << SDL_GetError() << std::endl;
@@ -185,31 +403,137 @@ int main()
     }
 
     // Load ROM
-    const std::string romPath = "roms/hello_world.nes";
-    loadROM(cpu,ppu,romPath);
+    loadROM(cartridge, cpu, ppu, romPath);
 
-    // Reset CPU and PPU
+    // Reset CPU, PPU and APU
     cpu.reset();
     ppu.reset();
+    apu.reset();
+
+    // The core runs on its own thread and publishes finished frames through a triple buffer,
+    // so presentation and vsync waits on this thread never stall emulation
+    std::atomic<bool> running(true);
+    std::atomic<uint8_t> buttonState(0);
+    TripleBuffer<Frame> frames;
+    FramePacer pacer;
+    pacer.setSyncSource(syncSource);
+
+    // Audio: the device callback drains a lock-free ring that the emulation thread fills once
+    // per frame. The emulated and host audio clocks drift apart, so each frame is resampled
+    // by up to 0.5% to hold the ring at the target latency. Without a device the emulator
+    // runs silently.
+    const double sampleRate = apu.getSampleRate();
+    AudioRing audioRing(static_cast<size_t>(sampleRate * std::max(0.25, audioLatency * 4)));
+    std::vector<int16_t> audioBlock(apu.getSampleRate() / 30); // Two frames of samples
+    std::vector<int16_t> resampledBlock(audioBlock.size() * 101 / 100 + Resampler::TAPS);
+    Resampler resampler;
+    RateControl rateControl(audioLatency * sampleRate);
+    SDL_AudioSpec audioSpec = {};
+    audioSpec.freq = apu.getSampleRate();
+    audioSpec.format = AUDIO_S16SYS;
+    audioSpec.channels = 1;
+    audioSpec.samples = 512;
+    audioSpec.callback = audioCallback;
+    audioSpec.userdata = &audioRing;
+    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(nullptr, 0, &audioSpec, nullptr, 0);
+    if (!audioDevice)
+    {
+        std::cerr << "Failed to open audio device: " << SDL_GetError() << std::endl;
+    }
+    else if (syncSource == SyncSource::AudioQueue)
+    {
+        pacer.setAudioQueue([&audioRing, sampleRate]() { return audioRing.fillLevel() / sampleRate; }, audioLatency);
+    }
 
-    // Main emulation loop
-    bool running = true;
-    Uint32 frameStart, frameTime;
+    // Viewer images are drawn on the emulation thread, between frames, only while the viewer is open
+    std::atomic<bool> viewerOpen(false);
+    std::unique_ptr<TripleBuffer<ViewerImage>> viewerImages(new TripleBuffer<ViewerImage>());
+    bool vsyncPaced = syncSource == SyncSource::Vsync;
 
-    while (running)
+    if (audioDevice)
     {
-        frameStart = SDL_GetTicks();
+        // Start with the target latency queued as silence so the first callbacks do not underrun
+        std::vector<int16_t> silence(static_cast<size_t>(audioLatency * sampleRate), 0);
+        audioRing.push(silence.data(), silence.size());
+        SDL_PauseAudioDevice(audioDevice, 0);
+    }
 
-        // Poll controller input
-        controller.pollKeyboard();
-        cpu.writeMemory(0x4016, controller.getButtonState());
+    std::thread emulationThread([&]()
+    {
+        bool frameRendered = false;
+        long frameCount = 0;
 
-        // Execute CPU instructions and render PPU frame
-        cpu.execute();
-        ppu.renderFrame();
+        while (running.load(std::memory_order_relaxed))
+        {
+            cpu.writeMemory(0x4016, buttonState.load(std::memory_order_relaxed));
+
+            bool copied = emulateFrame(cpu, ppu, apu, frameRendered, frames.writeBuffer());
+            int count = readFrameAudio(apu, audioBlock, audioDump, audioHash.get());
+            if (audioDevice)
+            {
+                resampler.setRatio(rateControl.update(audioRing.fillLevel()));
+                size_t resampled = resampler.process(audioBlock.data(), count, resampledBlock.data(), resampledBlock.size());
+                audioRing.push(resampledBlock.data(), resampled);
+            }
+
+            if (copied)
+            {
+                videoDump.writeFrame(frames.writeBuffer());
+                reportFrameHash(frames.writeBuffer(), ++frameCount, frameHashFrames);
+                frames.publish();
+
+                if (viewerOpen.load(std::memory_order_relaxed))
+                {
+                    renderViewer(ppu, viewerImages->writeBuffer());
+                    viewerImages->publish();
+                }
+
+                if (frameLimit != 0 && frameCount >= frameLimit)
+                    running = false;
+            }
+
+            pacer.waitForNextFrame();
+        }
+    });
+
+    // Presentation loop: input, events and display
+    DirtyRowTracker dirtyRows;
+    bool frameShown = false;
 
-        // Update the screen
-        displayFramebuffer(renderer, texture, ppu);
+    SDL_Window *viewerWindow = nullptr;
+    SDL_Renderer *viewerRenderer = nullptr;
+    SDL_Texture *viewerTexture = nullptr;
+    auto closeViewer = [&]()
+    {
+        viewerOpen = false;
+        SDL_DestroyTexture(viewerTexture);
+        SDL_DestroyRenderer(viewerRenderer);
+        SDL_DestroyWindow(viewerWindow);
+        viewerTexture = nullptr;
+        viewerRenderer = nullptr;
+        viewerWindow = nullptr;
+    };
+    auto openViewer = [&]()
+    {
+        viewerWindow = SDL_CreateWindow("PPU Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                        VIEWER_WIDTH, VIEWER_HEIGHT, SDL_WINDOW_SHOWN);
+        viewerRenderer = viewerWindow ? SDL_CreateRenderer(viewerWindow, -1, SDL_RENDERER_ACCELERATED) : nullptr;
+        viewerTexture = viewerRenderer ? SDL_CreateTexture(viewerRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                                           VIEWER_WIDTH, VIEWER_HEIGHT)
+                                       : nullptr;
+        if (!viewerTexture)
+        {
+            std::cerr << "Failed to open the PPU viewer: " << SDL_GetError() << std::endl;
+            closeViewer();
+            return;
+        }
+        viewerOpen = true;
+    };
+    while (running)
+    {
+        // Poll controller input
+        controller.pollKeyboard();
+        buttonState.store(controller.getButtonState(), std::memory_order_relaxed);
 
         // Handle events
         SDL_Event e;
@@ -219,21 +543,87 @@ int main()
             {
                 running = false;
             }
+            else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+            {
+                dirtyRows.invalidate(); // Texture contents were lost: upload the next frame in full
+            }
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2 && !e.key.repeat)
+            {
+                if (viewerWindow)
+                    closeViewer();
+                else
+                    openViewer();
+            }
+            else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE)
+            {
+                // With the viewer open, closing a window no longer quits by itself
+                if (viewerWindow && e.window.windowID == SDL_GetWindowID(viewerWindow))
+                    closeViewer();
+                else
+                    running = false;
+            }
+        }
+
+        // Show the newest completed frame; vsync paces this loop. Static screens upload nothing.
+        // When vsync paces emulation too, every refresh is presented and reported to the pacer.
+        if (frames.update() || (vsyncPaced && frameShown))
+        {
+            displayFramebuffer(renderer, texture, frames.readBuffer(), dirtyRows);
+            frameShown = true;
+            if (vsyncPaced)
+                pacer.signalVsync();
+        }
+        else if (vsyncPaced)
+        {
+            SDL_RenderClear(renderer);
+            SDL_RenderPresent(renderer);
+            pacer.signalVsync();
+        }
+        else
+        {
+            SDL_Delay(1);
         }
 
-        // Frame timing for ~60 FPS
-        frameTime = SDL_GetTicks() - frameStart;
-        if (frameTime < FRAME_DELAY)
+        if (viewerWindow && viewerImages->update())
         {
-            SDL_Delay(FRAME_DELAY - frameTime);
+            SDL_UpdateTexture(viewerTexture, nullptr, viewerImages->readBuffer().data(), VIEWER_WIDTH * 4);
+            SDL_RenderClear(viewerRenderer);
+            SDL_RenderCopy(viewerRenderer, viewerTexture, nullptr, nullptr);
+            SDL_RenderPresent(viewerRenderer);
         }
     }
 
+    if (viewerWindow)
+        closeViewer();
+    pacer.signalVsync(); // Release the emulation thread if it is waiting for a refresh
+    emulationThread.join();
+    std::cerr << pacer.formatJitterHistogram();
+    if (audioDevice)
+    {
+        SDL_CloseAudioDevice(audioDevice);
+        std::cerr << "Audio: " << audioRing.underruns() << " underruns (" << audioRing.missingSamples()
+                  << " samples), " << audioRing.dropped() << " samples dropped" << std::endl;
+    }
+    audioDump.close();
+    videoDump.close();
+
+    int result = 0;
+    if (videoDump.failed())
+    {
+        std::cerr << "Failed to write the video dump, the output is incomplete" << std::endl;
+        result = 1;
+    }
+    if (audioDump.failed())
+    {
+        std::cerr << "Failed to write the audio dump, the output is incomplete" << std::endl;
+        result = 1;
+    }
+
     // Cleanup SDL resources
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    return 0;
+    return result;
 }
@@ -0,0 +1,76 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring> // For strerror
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        std::cerr << "Failed to read the size of " << path << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    // An empty file has nothing to map; it opens with no data
+    void *mapping = nullptr;
+    if (info.st_size > 0)
+    {
+        mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Failed to map " << path << ": " << strerror(errno) << std::endl;
+            ::close(fd);
+            return false;
+        }
+    }
+    ::close(fd); // The mapping holds its own reference to the file
+
+    bytes = static_cast<const uint8_t *>(mapping);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+        munmap(const_cast<uint8_t *>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+}
@@ -0,0 +1,380 @@
+#include "mapper.h"
+#include "cartridge.h"
+#include "ppu.h"
+
+void Mapper::mapPrg16(int slot, int bank)
+{
+    cartridge.mapPrg(slot * 2, bank * 2);
+    cartridge.mapPrg(slot * 2 + 1, bank * 2 + 1);
+}
+
+void Mapper::mapPrg32(int bank)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        cartridge.mapPrg(i, bank * 4 + i);
+    }
+}
+
+void Mapper::mapChr2(int slot, int bank)
+{
+    cartridge.mapChr(slot * 2, bank * 2);
+    cartridge.mapChr(slot * 2 + 1, bank * 2 + 1);
+}
+
+void Mapper::mapChr4(int slot, int bank)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        cartridge.mapChr(slot * 4 + i, bank * 4 + i);
+    }
+}
+
+void Mapper::mapChr8(int bank)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        cartridge.mapChr(i, bank * 8 + i);
+    }
+}
+
+namespace
+{
+    // Mapper 0: 16KB (mirrored) or 32KB of PRG, 8KB of CHR, no registers
+    class NROM : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            mapPrg16(0, 0);
+            mapPrg16(1, -1);
+            mapChr8(0);
+        }
+
+        void writeRegister(uint16_t, uint8_t) override {}
+    };
+
+    // Mapper 1: a 5-bit shift register loaded one bit per write; the fifth write stores it in
+    // the register selected by address bits 13-14
+    class MMC1 : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            shift = 0x10;
+            control = 0x0C; // PRG mode 3: last bank fixed at $C000
+            chrBank0 = chrBank1 = prgBank = 0;
+            apply();
+        }
+
+        void writeRegister(uint16_t address, uint8_t value) override
+        {
+            if (value & 0x80)
+            {
+                shift = 0x10;
+                control |= 0x0C;
+                apply();
+                return;
+            }
+
+            bool full = shift & 0x01; // The marker bit reaches bit 0 on the fifth write
+            shift = (shift >> 1) | ((value & 0x01) << 4);
+            if (!full)
+                return;
+
+            switch ((address >> 13) & 0x03)
+            {
+            case 0:
+                control = shift;
+                break;
+            case 1:
+                chrBank0 = shift;
+                break;
+            case 2:
+                chrBank1 = shift;
+                break;
+            default:
+                prgBank = shift & 0x0F;
+                break;
+            }
+            shift = 0x10;
+            apply();
+        }
+
+    private:
+        void apply()
+        {
+            static const Mirroring MIRRORING[4] = {Mirroring::SingleScreenA, Mirroring::SingleScreenB,
+                                                   Mirroring::Vertical, Mirroring::Horizontal};
+            cartridge.setMirroring(MIRRORING[control & 0x03]);
+
+            // 512KB boards (SUROM) select the 256KB half with bit 4 of the CHR register
+            int outer = cartridge.getPrgSize() > 0x40000 ? (chrBank0 & 0x10) : 0;
+            switch ((control >> 2) & 0x03)
+            {
+            case 0:
+            case 1:
+                mapPrg32((outer | prgBank) >> 1);
+                break;
+            case 2:
+                mapPrg16(0, outer);
+                mapPrg16(1, outer | prgBank);
+                break;
+            default:
+                mapPrg16(0, outer | prgBank);
+                mapPrg16(1, outer | 0x0F);
+                break;
+            }
+
+            if (control & 0x10)
+            {
+                mapChr4(0, chrBank0);
+                mapChr4(1, chrBank1);
+            }
+            else
+            {
+                mapChr8(chrBank0 >> 1);
+            }
+        }
+
+        uint8_t shift;
+        uint8_t control;
+        uint8_t chrBank0;
+        uint8_t chrBank1;
+        uint8_t prgBank;
+    };
+
+    // Mapper 2: switchable 16KB at $8000, last bank fixed at $C000. The written value is ANDed
+    // with the ROM byte at the address (bus conflict), as on the discrete boards.
+    class UxROM : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            mapPrg16(0, 0);
+            mapPrg16(1, -1);
+            mapChr8(0);
+        }
+
+        void writeRegister(uint16_t address, uint8_t value) override
+        {
+            mapPrg16(0, value & cartridge.readPrg(address));
+        }
+    };
+
+    // Mapper 3: fixed PRG, switchable 8KB CHR, with bus conflicts
+    class CNROM : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            mapPrg16(0, 0);
+            mapPrg16(1, -1);
+            mapChr8(0);
+        }
+
+        void writeRegister(uint16_t address, uint8_t value) override
+        {
+            mapChr8(value & cartridge.readPrg(address));
+        }
+    };
+
+    // Mapper 7: switchable 32KB PRG and a single-screen nametable selected by bit 4
+    class AxROM : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            mapPrg32(0);
+            mapChr8(0);
+            cartridge.setMirroring(Mirroring::SingleScreenA);
+        }
+
+        void writeRegister(uint16_t, uint8_t value) override
+        {
+            mapPrg32(value & 0x07);
+            cartridge.setMirroring((value & 0x10) ? Mirroring::SingleScreenB : Mirroring::SingleScreenA);
+        }
+    };
+
+    // Mapper 4: eight bank registers (two 2KB and four 1KB CHR banks, two 8KB PRG banks) and a
+    // scanline counter that raises an IRQ when it reaches zero.
+    //
+    // The counter is clocked by PPU A12 rising, once per rendered line at dot 260 with the usual
+    // pattern table setup (background $0000, sprites $1000). Those dots are at fixed CPU cycles
+    // of the frame, so the counter is caught up lazily like the APU, and the cycle of its next
+    // IRQ is an event for the CPU.
+    class MMC3 : public Mapper
+    {
+    public:
+        using Mapper::Mapper;
+
+        void reset() override
+        {
+            static const uint8_t POWER_ON_BANKS[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+            for (int i = 0; i < 8; ++i)
+            {
+                banks[i] = POWER_ON_BANKS[i];
+            }
+            bankSelect = 0;
+            irqLatch = 0;
+            irqCounter = 0;
+            irqReload = false;
+            irqEnabled = false;
+            irqPending = false;
+            nextClock = 0;
+            cartridge.setIrq(false);
+            apply();
+        }
+
+        void writeRegister(uint16_t address, uint8_t value) override
+        {
+            switch (address & 0xE001)
+            {
+            case 0x8000:
+                bankSelect = value;
+                apply();
+                break;
+            case 0x8001:
+                banks[bankSelect & 0x07] = value;
+                apply();
+                break;
+            case 0xA000:
+                cartridge.setMirroring((value & 0x01) ? Mirroring::Horizontal : Mirroring::Vertical);
+                break;
+            case 0xC000:
+                irqLatch = value;
+                break;
+            case 0xC001:
+                irqCounter = 0;
+                irqReload = true;
+                break;
+            case 0xE000:
+                irqEnabled = false;
+                irqPending = false; // Disabling also acknowledges
+                cartridge.setIrq(false);
+                break;
+            case 0xE001:
+                irqEnabled = true;
+                break;
+            default: // $A001: PRG-RAM protect, not emulated
+                break;
+            }
+        }
+
+        // Clocks left until the counter next reaches zero, then the cycle of that clock
+        int nextIrqCycle() const override
+        {
+            if (!irqEnabled || irqPending || !cartridge.renderingEnabled())
+                return INT_MAX;
+
+            int clocks = (irqCounter == 0 || irqReload) ? irqLatch + 1 : irqCounter;
+            int n = nextClock + clocks - 1;
+            return (n / CLOCKS_PER_FRAME) * PPU::CPU_CYCLES_PER_FRAME + clockCycle(n % CLOCKS_PER_FRAME);
+        }
+
+        void catchUp(int cycle) override
+        {
+            bool rendering = cartridge.renderingEnabled();
+            while (nextClock < CLOCKS_PER_FRAME && clockCycle(nextClock) <= cycle)
+            {
+                if (rendering)
+                    clockCounter();
+                ++nextClock;
+            }
+        }
+
+        void endFrame(int frameCycles) override
+        {
+            catchUp(frameCycles);
+            nextClock = 0;
+        }
+
+    private:
+        // The pre-render line and the 240 visible lines; the frame starts at VBlank
+        static constexpr int CLOCKS_PER_FRAME = 241;
+
+        static int clockCycle(int clock)
+        {
+            return PPU::scanlineStartCycle(clock - 1) + 260 / 3; // Dot 260; clock 0 is the pre-render line
+        }
+
+        void clockCounter()
+        {
+            if (irqCounter == 0 || irqReload)
+            {
+                irqCounter = irqLatch;
+                irqReload = false;
+            }
+            else
+            {
+                --irqCounter;
+            }
+
+            if (irqCounter == 0 && irqEnabled && !irqPending)
+            {
+                irqPending = true;
+                cartridge.setIrq(true);
+            }
+        }
+
+        void apply()
+        {
+            // Bit 7 swaps the 2KB and 1KB halves of the pattern tables
+            int chrHalf = (bankSelect & 0x80) ? 4 : 0;
+            mapChr2(chrHalf >> 1, banks[0] >> 1);
+            mapChr2((chrHalf >> 1) + 1, banks[1] >> 1);
+            for (int i = 0; i < 4; ++i)
+            {
+                cartridge.mapChr((chrHalf ^ 4) + i, banks[2 + i]);
+            }
+
+            // Bit 6 swaps $8000 and $C000; the second-to-last bank takes the other one
+            bool swapped = bankSelect & 0x40;
+            cartridge.mapPrg(0, swapped ? -2 : banks[6] & 0x3F);
+            cartridge.mapPrg(1, banks[7] & 0x3F);
+            cartridge.mapPrg(2, swapped ? banks[6] & 0x3F : -2);
+            cartridge.mapPrg(3, -1);
+        }
+
+        uint8_t banks[8];
+        uint8_t bankSelect;
+        uint8_t irqLatch;
+        uint8_t irqCounter;
+        bool irqReload;
+        bool irqEnabled;
+        bool irqPending;
+        int nextClock; // Next counter clock of the frame, CLOCKS_PER_FRAME when done
+    };
+}
+
+std::unique_ptr<Mapper> Mapper::create(int number, Cartridge &cartridge)
+{
+    switch (number)
+    {
+    case 0:
+        return std::unique_ptr<Mapper>(new NROM(cartridge));
+    case 1:
+        return std::unique_ptr<Mapper>(new MMC1(cartridge));
+    case 2:
+        return std::unique_ptr<Mapper>(new UxROM(cartridge));
+    case 3:
+        return std::unique_ptr<Mapper>(new CNROM(cartridge));
+    case 4:
+        return std::unique_ptr<Mapper>(new MMC3(cartridge));
+    case 7:
+        return std::unique_ptr<Mapper>(new AxROM(cartridge));
+    default:
+        return nullptr;
+    }
+}
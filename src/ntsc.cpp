@@ -0,0 +1,187 @@
+#include "ntsc.h"
+#include "worker_pool.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+
+    // Composite levels of the four luma levels, low and high half of the colour wave, relative
+    // to sync (from the nesdev wiki NTSC video measurements)
+    const double levelLow[4] = {0.350, 0.518, 0.962, 1.550};
+    const double levelHigh[4] = {1.094, 1.506, 1.962, 1.962};
+    const double black = 0.518;
+    const double white = 1.962;
+    const double emphasisAttenuation = 0.746;
+
+    // Decoder hue and saturation, chosen so flat colours match the 2C02 palette of palette.cpp
+    const double hueOffset = 4.0; // In samples (30 degrees each)
+    const double chromaGain = 1.5;
+
+    // Each PPU pixel is 8 samples at the 21.48MHz master clock; the colour subcarrier repeats
+    // every 12 samples, so a pixel starts at phase 0, 4 or 8 and a scanline (341 x 8 samples)
+    // shifts the phase by 4
+    const int SAMPLES_PER_PIXEL = 8;
+    const int TAPS = 5; // Pixels -2..+2 reach an output pixel through the chroma window
+
+    struct alignas(16) Color
+    {
+        float v[4]; // R, G, B, unused
+    };
+
+    // Composite signal of 9-bit colour (emphasis << 6 | index) at one subcarrier phase,
+    // scaled so black is 0 and white is 1
+    double signalLevel(int color, int phase)
+    {
+        int hue = color & 0x0F;
+        int level = (color >> 4) & 0x03;
+        int emphasis = color >> 6;
+        if (hue > 13)
+            level = 1; // Columns $xE and $xF are black
+
+        double low = levelLow[level];
+        double high = levelHigh[level];
+        if (hue == 0)
+            low = high; // Greys have no colour wave
+        if (hue > 12)
+            high = low;
+
+        auto inPhase = [phase](int h) { return (h + phase) % 12 < 6; };
+        double signal = inPhase(hue) ? high : low;
+
+        // Each emphasis bit attenuates the signal during one third of the colour wave
+        if (((emphasis & 1) && inPhase(0)) || ((emphasis & 2) && inPhase(4)) || ((emphasis & 4) && inPhase(8)))
+            signal *= emphasisAttenuation;
+
+        return (signal - black) / (white - black);
+    }
+
+    // kernel[color][phase][half][tap]: RGB added to output pixel 2x+half by the pixel at x+tap-2
+    // when pixel x starts at subcarrier phase 4*phase
+    struct Kernels
+    {
+        std::vector<Color> table;
+
+        static size_t index(int color, int phase, int half, int tap)
+        {
+            return ((static_cast<size_t>(color) * 3 + phase) * 2 + half) * TAPS + tap;
+        }
+
+        Kernels() : table(512 * 3 * 2 * TAPS)
+        {
+            for (int color = 0; color < 512; ++color)
+            {
+                for (int phase = 0; phase < 3; ++phase)
+                {
+                    for (int half = 0; half < 2; ++half)
+                    {
+                        // Decoder centre, in samples from the start of pixel x
+                        int centre = 2 + half * 4;
+
+                        for (int tap = 0; tap < TAPS; ++tap)
+                        {
+                            double y = 0, i = 0, q = 0;
+                            for (int s = 0; s < SAMPLES_PER_PIXEL; ++s)
+                            {
+                                int position = (tap - 2) * SAMPLES_PER_PIXEL + s;
+                                int samplePhase = (phase * 4 + position % 12 + 12) % 12;
+                                double signal = signalLevel(color, samplePhase);
+
+                                // Luma: one subcarrier period, which cancels the colour wave.
+                                // Chroma: two periods, for the softer colour of a real decoder.
+                                int offset = position - centre;
+                                if (offset >= -6 && offset < 6)
+                                    y += signal / 12;
+                                if (offset >= -12 && offset < 12)
+                                {
+                                    double angle = PI * (samplePhase + hueOffset) / 6;
+                                    i += chromaGain * signal * std::cos(angle) / 24;
+                                    q += chromaGain * signal * std::sin(angle) / 24;
+                                }
+                            }
+
+                            // YIQ to RGB (FCC matrix)
+                            Color &out = table[index(color, phase, half, tap)];
+                            out.v[0] = static_cast<float>(y + 0.946882 * i + 0.623557 * q);
+                            out.v[1] = static_cast<float>(y - 0.274788 * i - 0.635691 * q);
+                            out.v[2] = static_cast<float>(y - 1.108545 * i + 1.709007 * q);
+                            out.v[3] = 0.0f;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    const Kernels &kernels()
+    {
+        static const Kernels instance;
+        return instance;
+    }
+
+    uint32_t packColor(const Color &c)
+    {
+        uint32_t rgb[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            float v = c.v[k] * 255.0f + 0.5f;
+            v = v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+            rgb[k] = static_cast<uint32_t>(v);
+        }
+        return 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+    }
+
+    void filterRow(const uint8_t *indices, uint8_t emphasis, int linePhase, uint32_t *out)
+    {
+        const Color *table = kernels().table.data();
+
+        // Colours with emphasis, padded with black on both sides for the outer taps
+        uint16_t colors[256 + 4];
+        uint16_t blackColor = static_cast<uint16_t>((emphasis << 6) | 0x0F);
+        colors[0] = colors[1] = colors[258] = colors[259] = blackColor;
+        for (int x = 0; x < 256; ++x)
+        {
+            colors[x + 2] = static_cast<uint16_t>((emphasis << 6) | (indices[x] & 0x3F));
+        }
+
+        int phase = linePhase;
+        for (int x = 0; x < 256; ++x)
+        {
+            for (int half = 0; half < 2; ++half)
+            {
+                Color sum = {};
+                for (int tap = 0; tap < TAPS; ++tap)
+                {
+                    const Color &k = table[Kernels::index(colors[x + tap], phase, half, tap)];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        sum.v[c] += k.v[c];
+                    }
+                }
+                out[x * 2 + half] = packColor(sum);
+            }
+            phase = phase == 0 ? 2 : phase - 1; // +8 samples: phase index advances by 2 (mod 3)
+        }
+    }
+}
+
+void ntscFilterFrame(const uint8_t *indices, const uint8_t *lineEmphasis, int height, int framePhase,
+                     uint32_t *output, int pitch, WorkerPool *pool)
+{
+    kernels(); // Build the tables before the workers need them
+
+    auto task = [=](int begin, int end)
+    {
+        for (int y = begin; y < end; ++y)
+        {
+            uint32_t *out = reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(output) + y * pitch);
+            filterRow(indices + y * 256, lineEmphasis[y] & 0x07, (framePhase + y) % 3, out);
+        }
+    };
+
+    if (pool)
+        pool->parallelFor(height, task);
+    else
+        task(0, height);
+}
@@ -0,0 +1,102 @@
+#include "palette.h"
+#include <array>
+#include <cstring> // For memcpy
+
+namespace
+{
+    // 2C02 master palette (RGB)
+    const uint32_t basePalette[64] = {
+        0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+        0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+        0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+        0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+        0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+        0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+        0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+        0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000};
+
+    // Lookup tables for all 8 emphasis combinations, built once on first use
+    struct PaletteTables
+    {
+        std::array<std::array<uint32_t, 64>, 8> argb;
+        std::array<std::array<uint16_t, 64>, 8> rgb565;
+
+        PaletteTables()
+        {
+            for (int emphasis = 0; emphasis < 8; ++emphasis)
+            {
+                // Each emphasis bit darkens the two other channels
+                double scaleR = ((emphasis & 0x02) ? 0.816 : 1.0) * ((emphasis & 0x04) ? 0.816 : 1.0);
+                double scaleG = ((emphasis & 0x01) ? 0.816 : 1.0) * ((emphasis & 0x04) ? 0.816 : 1.0);
+                double scaleB = ((emphasis & 0x01) ? 0.816 : 1.0) * ((emphasis & 0x02) ? 0.816 : 1.0);
+
+                for (int i = 0; i < 64; ++i)
+                {
+                    uint32_t r = static_cast<uint32_t>(((basePalette[i] >> 16) & 0xFF) * scaleR);
+                    uint32_t g = static_cast<uint32_t>(((basePalette[i] >> 8) & 0xFF) * scaleG);
+                    uint32_t b = static_cast<uint32_t>((basePalette[i] & 0xFF) * scaleB);
+
+                    argb[emphasis][i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+                    rgb565[emphasis][i] = static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+                }
+            }
+        }
+    };
+
+    const PaletteTables &tables()
+    {
+        static const PaletteTables instance;
+        return instance;
+    }
+
+    // Table lookups over contiguous rows; the loops are simple enough for the compiler to vectorize
+    template <typename Pixel>
+    void convertRows(const uint8_t *indices, const uint8_t *lineEmphasis, int width, int height,
+                     const std::array<std::array<Pixel, 64>, 8> &lut, uint8_t *output, int pitch)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            const Pixel *palette = lut[lineEmphasis[y] & 0x07].data();
+            const uint8_t *src = indices + y * width;
+            Pixel *dst = reinterpret_cast<Pixel *>(output + y * pitch);
+            for (int x = 0; x < width; ++x)
+            {
+                dst[x] = palette[src[x] & 0x3F];
+            }
+        }
+    }
+}
+
+const uint32_t *paletteARGB(uint8_t emphasis)
+{
+    return tables().argb[emphasis & 0x07].data();
+}
+
+const uint16_t *paletteRGB565(uint8_t emphasis)
+{
+    return tables().rgb565[emphasis & 0x07].data();
+}
+
+void convertFrame(const uint8_t *indices, const uint8_t *lineEmphasis, int width, int height,
+                  PixelFormat format, void *output, int pitch)
+{
+    uint8_t *out = static_cast<uint8_t *>(output);
+
+    switch (format)
+    {
+    case PixelFormat::ARGB8888:
+        convertRows(indices, lineEmphasis, width, height, tables().argb, out, pitch);
+        break;
+
+    case PixelFormat::RGB565:
+        convertRows(indices, lineEmphasis, width, height, tables().rgb565, out, pitch);
+        break;
+
+    case PixelFormat::Indexed:
+        for (int y = 0; y < height; ++y)
+        {
+            std::memcpy(out + y * pitch, indices + y * width, width);
+        }
+        break;
+    }
+}
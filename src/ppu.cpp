@@ -1,32 +1,137 @@
 #include "ppu.h"
 #include "cpu.h"    // Include CPU header for NMI triggering
-#include <cstring>  // For memset
+#include "worker_pool.h"
+#include "frame_hash.h"
+#include <algorithm> // For std::min
+#include <climits>  // For INT_MAX
+#include <cstring>  // For memset, memcpy
 #include <iostream> // For debugging logs
 
+// Mirror a pattern byte for horizontally flipped sprites
+static uint8_t reverseBits(uint8_t value)
+{
+    value = (value & 0xF0) >> 4 | (value & 0x0F) << 4;
+    value = (value & 0xCC) >> 2 | (value & 0x33) << 2;
+    value = (value & 0xAA) >> 1 | (value & 0x55) << 1;
+    return value;
+}
+
+// Map a scanline to its row in the scrolled nametable space: returns the row within a
+// nametable (0-239) and sets ntY to the nametable row it falls in
+static int scrolledRow(const PPU::ScanlineState &state, int scanline, int &ntY)
+{
+    int y = scanline + state.scrollY;
+    ntY = (state.ctrl >> 1) & 1;
+    while (y >= 240)
+    {
+        y -= 240;
+        ntY ^= 1;
+    }
+    return y;
+}
+
+// Pattern address of one sprite row (row already flipped), for 8x8 and 8x16 sprites
+static uint16_t spritePatternAddress(uint8_t ctrl, uint8_t tileIndex, int row)
+{
+    if (ctrl & 0x20)
+    {
+        // 8x16: bit 0 of the tile index selects the pattern table, the top half uses the
+        // even tile and the bottom half the next one
+        return ((tileIndex & 0x01) * 0x1000) + ((tileIndex & 0xFE) + (row >> 3)) * 16 + (row & 7);
+    }
+    return ((ctrl & 0x08) ? 0x1000 : 0x0000) + tileIndex * 16 + row;
+}
+
+static uint8_t paletteEntry(const uint8_t *memory, uint8_t entry)
+{
+    entry &= 0x1F;
+    if ((entry & 0x13) == 0x10)
+        entry &= 0x0F; // $3F10/$3F14/$3F18/$3F1C mirror $3F00/$3F04/$3F08/$3F0C
+    return memory[0x3F00 + entry];
+}
+
+// 2-bit background pixel at (x, scanline) as seen through the given nametable slots
+static uint8_t backgroundPixel(const PPU &ppu, const uint8_t *const slots[4],
+                               const PPU::ScanlineState &state, int scanline, int x)
+{
+    int ntY;
+    int y = scrolledRow(state, scanline, ntY);
+    int worldX = (state.ctrl & 0x01) * 256 + state.scrollX + x;
+    int column = (worldX >> 3) & 63;
+
+    uint8_t tileIndex = slots[(ntY << 1) | (column >> 5)][(y / 8) * 32 + (column & 31)];
+    uint16_t tileAddr = ((state.ctrl & 0x10) ? 0x1000 : 0x0000) + tileIndex * 16 + (y & 7);
+    const uint8_t *pattern = ppu.patternData(tileAddr);
+    int bit = 7 - (worldX & 7);
+    return ((pattern[0] >> bit) & 1) | (((pattern[8] >> bit) & 1) << 1);
+}
+
 PPU::PPU()
 {
     cpu = nullptr; // Initialize CPU pointer
+    frameInFlight = false;
+    writeLogCount = 0;
+    frameCount = 0;
+    replayCycle = 0;
     addressLatch = false;
     scrollLatch = false;
     fineXScroll = 0;
     fineYScroll = 0;
     PPUSCROLL = 0;
     PPUADDR = 0;
+    vramAddress = 0;
+    setMirroring(Mirroring::Vertical);
+    for (int slot = 0; slot < 8; ++slot)
+    {
+        chrPages[slot] = &memory[slot * 0x400];
+    }
+    chrWritable = true;
+    for (ChrPages &pages : scanlineChrPages)
+    {
+        std::copy(chrPages.begin(), chrPages.end(), pages.begin());
+    }
     reset();
 }
 
+PPU::~PPU()
+{
+    waitForFrame();
+}
+
 void PPU::reset()
 {
+    waitForFrame();
+
     PPUCTRL = PPUMASK = PPUSTATUS = OAMADDR = PPUSCROLL = PPUADDR = PPUDATA = 0;
 
     addressLatch = false;
     scrollLatch = false;
     fineXScroll = 0;
     fineYScroll = 0;
+    vramAddress = 0;
 
     memory.fill(0);
     oam.fill(0);
     framebuffer.fill(0);
+    lineEmphasis.fill(0);
+    backgroundOpaque.fill(0);
+    attributesDirty = true;
+    for (int scanline = 0; scanline < 240; ++scanline)
+    {
+        hashLine(scanline);
+    }
+    oamDirty = true;
+
+    scanlineLog.fill({});
+    nextScanline = 0;
+    preRenderDone = false;
+    spriteZeroHitCycle = -1;
+}
+
+void PPU::setChrPage(int slot, uint8_t *page)
+{
+    syncScanlines(currentCycle());
+    chrPages[slot] = page;
 }
 
 void PPU::setCPU(CPU *cpuInstance)
@@ -37,11 +142,20 @@ void PPU::setCPU(CPU *cpuInstance)
 // WRITE REGISTER - Handles CPU writes to PPU registers
 void PPU::writeRegister(uint16_t address, uint8_t value)
 {
+    // Scanlines the CPU has already passed keep the register values from before this write
+    syncScanlines(currentCycle());
+
+    if (!writeLog.empty())
+        logAccess(RegisterAccess::Write, address & 0x07, value);
+
     switch (address)
     {
     case 0x2000: // PPUCTRL
         std::cerr << "[PPU Debug] Old PPUCTRL: 0x" << std::hex << static_cast<int>(PPUCTRL) << std::endl;
 
+        if ((PPUCTRL ^ value) & 0x20)
+            oamDirty = true; // Sprite size changed: line sprite lists must be rebuilt
+
         PPUCTRL = value;
 
         std::cerr << "[PPU Debug] New PPUCTRL written: 0x" << std::hex << static_cast<int>(PPUCTRL)
@@ -74,6 +188,7 @@ void PPU::writeRegister(uint16_t address, uint8_t value)
 
     case 0x2004: // OAMDATA
         oam[OAMADDR++] = value;
+        oamDirty = true;
         break;
 
     case 0x2005: // PPUSCROLL
@@ -92,20 +207,35 @@ void PPU::writeRegister(uint16_t address, uint8_t value)
     case 0x2006: // PPUADDR
         if (!addressLatch)
         {
-            PPUADDR = (PPUADDR & 0x00FF) | (value << 8); // High byte
+            vramAddress = (vramAddress & 0x00FF) | ((value & 0x3F) << 8); // High byte
             addressLatch = true;
         }
         else
         {
-            PPUADDR = (PPUADDR & 0xFF00) | value; // Low byte
+            vramAddress = (vramAddress & 0xFF00) | value; // Low byte
             addressLatch = false;
         }
+        PPUADDR = value; // PPUADDR holds the last written byte
         break;
 
     case 0x2007: // PPUDATA
-        memory[resolveNametableAddress(PPUADDR & 0x3FFF)] = value;
-        PPUADDR += (PPUCTRL & 0x04) ? 32 : 1; // Increment by 32 if bit 2 is set
-        PPUADDR &= 0x3FFF;                    // Wrap PPUADDR to 14 bits
+        if (vramAddress >= 0x2000 && vramAddress < 0x3F00)
+        {
+            uint8_t *nametable = nametableSlots[(vramAddress >> 10) & 3];
+            uint16_t offset = vramAddress & 0x3FF;
+            nametable[offset] = value;
+            if (offset >= 0x3C0)
+                updateAttribute(static_cast<int>((nametable - &memory[0x2000]) >> 10), offset - 0x3C0, value);
+        }
+        else if (vramAddress < 0x2000)
+        {
+            if (chrWritable)
+                chrPages[vramAddress >> 10][vramAddress & 0x3FF] = value;
+        }
+        else
+            memory[resolveNametableAddress(vramAddress)] = value;
+        vramAddress += (PPUCTRL & 0x04) ? 32 : 1; // Increment by 32 if bit 2 is set
+        vramAddress &= 0x3FFF;                    // Wrap the VRAM address to 14 bits
         break;
 
     default:
@@ -119,6 +249,8 @@ uint8_t PPU::readRegister(uint16_t address)
 {
     uint8_t data = 0;
 
+    syncScanlines(currentCycle()); // Bring VBlank, sprite 0 hit and overflow up to date
+
     switch (address)
     {
     case 0x2002: // PPUSTATUS
@@ -136,10 +268,14 @@ uint8_t PPU::readRegister(uint16_t address)
 
     case 0x2007: // PPUDATA
     {
-        uint16_t resolvedAddr = resolveNametableAddress(PPUADDR & 0x3FFF);
-        data = memory[resolvedAddr];
-        PPUADDR += (PPUCTRL & 0x04) ? 32 : 1; // Increment based on PPUCTRL
-        PPUADDR &= 0x3FFF;                    // Wrap PPUADDR
+        if (vramAddress >= 0x2000 && vramAddress < 0x3F00)
+            data = nametableSlots[(vramAddress >> 10) & 3][vramAddress & 0x3FF];
+        else if (vramAddress < 0x2000)
+            data = chrPages[vramAddress >> 10][vramAddress & 0x3FF];
+        else
+            data = memory[resolveNametableAddress(vramAddress)];
+        vramAddress += (PPUCTRL & 0x04) ? 32 : 1; // Increment based on PPUCTRL
+        vramAddress &= 0x3FFF;                    // Wrap the VRAM address
         break;
     }
 
@@ -148,22 +284,248 @@ uint8_t PPU::readRegister(uint16_t address)
         break;
     }
 
+    if (!writeLog.empty() && (address == 0x2002 || address == 0x2007))
+        logAccess(RegisterAccess::Read, address & 0x07, data);
+
     return data;
 }
 
+int PPU::currentCycle() const
+{
+    return cpu ? cpu->cycles : replayCycle;
+}
+
+void PPU::enableWriteLog(size_t capacity)
+{
+    size_t size = 0;
+    if (capacity)
+    {
+        size = 1;
+        while (size < capacity)
+            size <<= 1;
+    }
+    writeLog.assign(size, RegisterWrite{});
+    writeLogCount = 0;
+    if (size)
+        logFrameStart(); // Exact for this frame only if logging starts at its VBlank
+}
+
+void PPU::logAccess(RegisterAccess access, uint8_t reg, uint8_t value)
+{
+    int cycle = access == RegisterAccess::FrameStart ? 0 : currentCycle();
+    int dots = cycle * 3;
+
+    RegisterWrite &entry = writeLog[writeLogCount++ & (writeLog.size() - 1)];
+    entry.frame = frameCount;
+    entry.cycle = cycle;
+    entry.scanline = static_cast<int16_t>((241 + dots / 341) % 262); // Frames start at VBlank
+    entry.dot = static_cast<uint16_t>(dots % 341);
+    entry.reg = reg;
+    entry.value = value;
+    entry.access = access;
+}
+
+// The state a replay cannot rebuild from the frame's accesses alone
+void PPU::logFrameStart()
+{
+    const uint8_t fields[RegisterWrite::FIELD_COUNT] = {
+        PPUCTRL, PPUMASK, PPUSTATUS, OAMADDR, fineXScroll, fineYScroll,
+        static_cast<uint8_t>(vramAddress >> 8), static_cast<uint8_t>(vramAddress & 0xFF),
+        static_cast<uint8_t>((addressLatch ? 0x01 : 0) | (scrollLatch ? 0x02 : 0))};
+    for (uint8_t field = 0; field < RegisterWrite::FIELD_COUNT; ++field)
+    {
+        logAccess(RegisterAccess::FrameStart, field, fields[field]);
+    }
+}
+
+std::vector<RegisterWrite> PPU::getFrameWrites(uint32_t frame) const
+{
+    std::vector<RegisterWrite> writes;
+    size_t available = std::min(writeLogCount, writeLog.size());
+    for (size_t i = writeLogCount - available; i < writeLogCount; i++)
+    {
+        const RegisterWrite &entry = writeLog[i & (writeLog.size() - 1)];
+        if (entry.frame == frame)
+            writes.push_back(entry);
+    }
+    return writes;
+}
+
+void PPU::replayFrame(const std::vector<RegisterWrite> &writes)
+{
+    // Time the accesses from the log rather than from a CPU
+    CPU *linkedCPU = cpu;
+    cpu = nullptr;
+
+    for (const RegisterWrite &entry : writes)
+    {
+        replayCycle = entry.cycle;
+        if (entry.access == RegisterAccess::Write)
+            writeRegister(0x2000 + entry.reg, entry.value);
+        else if (entry.access == RegisterAccess::Read)
+            readRegister(0x2000 + entry.reg);
+        else
+            restoreField(entry.reg, entry.value);
+    }
+
+    replayCycle = CPU_CYCLES_PER_FRAME;
+    renderFrame();
+    replayCycle = 0;
+    cpu = linkedCPU;
+}
+
+void PPU::restoreField(uint8_t field, uint8_t value)
+{
+    switch (field)
+    {
+    case RegisterWrite::CTRL:
+        if ((PPUCTRL ^ value) & 0x20)
+            oamDirty = true; // Sprite size changed
+        PPUCTRL = value;
+        break;
+    case RegisterWrite::MASK:
+        PPUMASK = value;
+        break;
+    case RegisterWrite::STATUS:
+        PPUSTATUS = value;
+        break;
+    case RegisterWrite::OAM_ADDRESS:
+        OAMADDR = value;
+        break;
+    case RegisterWrite::SCROLL_X:
+        fineXScroll = value;
+        break;
+    case RegisterWrite::SCROLL_Y:
+        fineYScroll = value;
+        break;
+    case RegisterWrite::VRAM_HIGH:
+        vramAddress = (vramAddress & 0x00FF) | (value << 8);
+        break;
+    case RegisterWrite::VRAM_LOW:
+        vramAddress = (vramAddress & 0xFF00) | value;
+        break;
+    case RegisterWrite::LATCHES:
+        addressLatch = value & 0x01;
+        scrollLatch = value & 0x02;
+        break;
+    default:
+        break;
+    }
+}
+
+// Catch the scanline timing up to a CPU cycle of the current frame. Nothing is stepped per
+// cycle: this runs when the CPU touches a PPU register and once at the end of the frame.
+void PPU::syncScanlines(int cycle)
+{
+    // Pre-render line: VBlank, sprite 0 hit and sprite overflow are cleared for the new frame
+    if (!preRenderDone && cycle >= scanlineStartCycle(-1))
+    {
+        PPUSTATUS &= ~0xE0;
+        preRenderDone = true;
+    }
+
+    while (nextScanline < 240 && cycle >= scanlineStartCycle(nextScanline))
+    {
+        latchScanline(nextScanline);
+        ++nextScanline;
+    }
+
+    if (spriteZeroHitCycle >= 0 && cycle >= spriteZeroHitCycle)
+    {
+        PPUSTATUS |= 0x40;
+        spriteZeroHitCycle = -1;
+    }
+}
+
+// Record the registers a scanline is drawn with and work out its status flag effects.
+// Only sprite 0's pixels are examined here; the full line is drawn later.
+void PPU::latchScanline(int scanline)
+{
+    scanlineLog[scanline] = {PPUCTRL, PPUMASK, fineXScroll, fineYScroll};
+    std::copy(chrPages.begin(), chrPages.end(), scanlineChrPages[scanline].begin());
+
+    if ((PPUMASK & 0x18) == 0)
+        return; // Sprite evaluation only runs while rendering is enabled
+
+    evaluateSprites();
+    const SpriteLine &sprites = spriteLines[scanline];
+
+    if (sprites.overflow)
+        PPUSTATUS |= 0x20; // Sprite overflow
+
+    if (sprites.hasSpriteZero && (PPUMASK & 0x18) == 0x18 && !(PPUSTATUS & 0x40) && spriteZeroHitCycle < 0)
+    {
+        int x = findSpriteZeroHit(scanline);
+        if (x >= 0)
+            spriteZeroHitCycle = scanlineStartCycle(scanline) + (x + 2) / 3; // Pixel x is output at dot x + 2
+    }
+}
+
+// First x where an opaque sprite 0 pixel overlaps an opaque background pixel, or -1.
+// Both layers must be enabled, x = 255 never hits, and the left 8 pixels only hit when
+// neither layer is clipped there.
+int PPU::findSpriteZeroHit(int scanline) const
+{
+    const ScanlineState &state = scanlineLog[scanline];
+    const uint8_t *entry = &spriteLines[scanline].oam[0];
+    const int spriteHeight = (state.ctrl & 0x20) ? 16 : 8;
+
+    int row = scanline - (entry[0] + 1);
+    if (entry[2] & 0x80)
+        row = spriteHeight - 1 - row;
+
+    const uint8_t *pattern = patternData(spritePatternAddress(state.ctrl, entry[1], row));
+    uint8_t plane1 = pattern[0];
+    uint8_t plane2 = pattern[8];
+    if (entry[2] & 0x40)
+    {
+        plane1 = reverseBits(plane1);
+        plane2 = reverseBits(plane2);
+    }
+
+    const int firstX = (state.mask & 0x06) == 0x06 ? 0 : 8;
+    for (int col = 0; col < 8; ++col)
+    {
+        int x = entry[3] + col;
+        if (x < firstX || x >= 255 || !(((plane1 | plane2) >> (7 - col)) & 1))
+            continue;
+        if (backgroundPixel(*this, nametableSlots, state, scanline, x))
+            return x;
+    }
+    return -1;
+}
+
 void PPU::renderFrame()
 {
-    // Render the background and sprites
-    renderBackground();
-    renderSprites();
+    // Latch the scanlines the CPU did not reach through register accesses
+    syncScanlines(INT_MAX);
+    captureFrameState(false);
 
-    debugNametable(0x2000);
+    nextScanline = 0;
+    preRenderDone = false;
+    spriteZeroHitCycle = -1;
+    frameCount++;
+
+    // Draw the frame from the captured state, on the workers if there are any
+    if (renderPool)
+    {
+        frameInFlight = true;
+        renderPool->dispatch(240, [this](int begin, int end)
+                             { drawLines(begin, end); });
+    }
+    else
+    {
+        drawLines(0, 240);
+    }
 
     // Set VBlank flag in PPUSTATUS (bit 7)
     PPUSTATUS |= 0x80; // Indicates the start of VBlank
     std::cerr << "[PPU Debug] VBlank flag set. PPUSTATUS: 0b"
               << std::bitset<8>(PPUSTATUS) << std::endl;
 
+    if (!writeLog.empty())
+        logFrameStart(); // The next frame starts here
+
     // Check if NMI is enabled in PPUCTRL (bit 7)
     if (PPUCTRL & 0x80) // NMI enable flag
     {
@@ -184,92 +546,319 @@ void PPU::renderFrame()
         // Log if NMI is not enabled
         std::cerr << "[PPU Debug] NMI not enabled in PPUCTRL." << std::endl;
     }
+}
+
+void PPU::setRenderThreads(int count)
+{
+    waitForFrame();
+    renderPool.reset(count > 0 ? new WorkerPool(count) : nullptr);
+}
+
+void PPU::waitForFrame()
+{
+    if (frameInFlight)
+    {
+        renderPool->wait();
+        frameInFlight = false;
+    }
+}
+
+void PPU::copyFrame(Frame &frame)
+{
+    waitForFrame();
+    frame.pixels = framebuffer;
+    frame.emphasis = lineEmphasis;
+    frame.rowHashes = rowHashes;
+    frame.hash = hashFrameRows(rowHashes.data(), 240);
+}
+
+uint64_t PPU::frameHash()
+{
+    waitForFrame();
+    return hashFrameRows(rowHashes.data(), 240);
+}
+
+// Snapshot what the renderer needs. fromRegisters draws every line with the current
+// registers instead of the scanline log (used by renderBackground()/renderSprites()).
+void PPU::captureFrameState(bool fromRegisters)
+{
+    waitForFrame();
+    evaluateSprites();
+
+    if (fromRegisters)
+    {
+        frameState.scanlines.fill({PPUCTRL, PPUMASK, fineXScroll, fineYScroll});
+        std::copy(chrPages.begin(), chrPages.end(), frameState.chrPages[0].begin());
+        frameState.chrPages.fill(frameState.chrPages[0]);
+    }
+    else
+    {
+        frameState.scanlines = scanlineLog;
+        frameState.chrPages = scanlineChrPages;
+    }
+
+    if (attributesDirty)
+        rebuildAttributeCache();
 
-    // Optionally clear the VBlank flag before the next frame (based on timing in the main loop)
-    // PPUSTATUS &= ~0x80; // Uncomment if clearing before rendering the next frame
+    frameState.spriteLines = spriteLines;
+    frameState.memory = memory;
+    if (chrWritable)
+        copyWritableChrPages();
+    frameState.attributes = attributeCache;
+    for (int slot = 0; slot < 4; ++slot)
+    {
+        frameState.nametablePages[slot] = static_cast<uint16_t>(nametableSlots[slot] - memory.data());
+    }
+}
+
+// CHR-ROM pages never change, so the renderer reads them in place. CHR-RAM may be written
+// while the workers draw, so each distinct page the frame shows is copied once and the
+// scanlines are pointed at the copies.
+void PPU::copyWritableChrPages()
+{
+    std::vector<const uint8_t *> &sources = frameState.chrSources;
+    sources.clear();
+    for (const ChrPages &pages : frameState.chrPages)
+    {
+        for (const uint8_t *page : pages)
+        {
+            if (std::find(sources.begin(), sources.end(), page) == sources.end())
+                sources.push_back(page);
+        }
+    }
+
+    if (frameState.chrCopies.size() < sources.size())
+        frameState.chrCopies.resize(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        std::memcpy(frameState.chrCopies[i].data(), sources[i], 0x400);
+    }
+
+    for (ChrPages &pages : frameState.chrPages)
+    {
+        for (const uint8_t *&page : pages)
+        {
+            size_t index = std::find(sources.begin(), sources.end(), page) - sources.begin();
+            page = frameState.chrCopies[index].data();
+        }
+    }
+}
+
+void PPU::drawLines(int begin, int end)
+{
+    for (int scanline = begin; scanline < end; ++scanline)
+    {
+        drawBackgroundLine(scanline);
+        drawSpriteLine(scanline);
+        hashLine(scanline);
+    }
+}
+
+// Row hashes are taken by whichever thread drew the row, so they cost the frontend nothing
+void PPU::hashLine(int scanline)
+{
+    rowHashes[scanline] = hash64(&framebuffer[scanline * 256], 256, lineEmphasis[scanline]);
 }
 
 void PPU::renderBackground()
 {
-    const uint16_t baseNametable[4] = {0x2000, 0x2400, 0x2800, 0x2C00};
-    uint16_t nametableBase = baseNametable[PPUCTRL & 0x03]; // Determine the base nametable dynamically
-    const uint16_t patternTableBase = (PPUCTRL & 0x10) ? 0x1000 : 0x0000;
+    captureFrameState(true);
+    for (int scanline = 0; scanline < 240; ++scanline)
+    {
+        drawBackgroundLine(scanline);
+        hashLine(scanline);
+    }
+}
+
+void PPU::drawBackgroundLine(int scanline)
+{
+    const ScanlineState &state = frameState.scanlines[scanline];
+    const uint8_t *vram = frameState.memory.data();
+    const ChrPages &chr = frameState.chrPages[scanline];
+    const uint16_t patternTableBase = (state.ctrl & 0x10) ? 0x1000 : 0x0000;
 
     const int screenWidth = 256;
-    const int screenHeight = 240;
+    int ntY;
+    const int y = scrolledRow(state, scanline, ntY);
+    const int tileY = y / 8;
+    const int row = y % 8;
+
+    uint8_t *line = &framebuffer[scanline * screenWidth];
+    uint8_t *opaque = &backgroundOpaque[scanline * screenWidth];
+
+    // Greyscale mode keeps only the luminance column of the palette
+    const uint8_t colorMask = (state.mask & 0x01) ? 0x30 : 0x3F;
+    uint8_t palette[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        palette[i] = paletteEntry(vram, i) & colorMask;
+    }
+    lineEmphasis[scanline] = state.mask >> 5;
 
-    for (int tileY = 0; tileY < 30; ++tileY)
+    // PPUMASK bit 3 hides the background: the line shows the backdrop
+    if (!(state.mask & 0x08))
     {
-        for (int tileX = 0; tileX < 32; ++tileX)
+        std::memset(line, palette[0], screenWidth);
+        std::memset(opaque, 0, screenWidth);
+        return;
+    }
+
+    // Decode the 33 tiles the scrolled line touches into background palette entries (0 where
+    // transparent, which is the backdrop), then keep the 256 pixels after fine X
+    uint8_t pixels[33 * 8];
+    const int firstColumn = (state.ctrl & 0x01) * 32 + (state.scrollX >> 3);
+    for (int tile = 0; tile < 33; ++tile)
+    {
+        int column = (firstColumn + tile) & 63;
+        int slot = (ntY << 1) | (column >> 5);
+        int tileOffset = tileY * 32 + (column & 31);
+        uint8_t tileIndex = vram[frameState.nametablePages[slot] + tileOffset];
+        uint8_t paletteBase = frameState.attributes[(frameState.nametablePages[slot] - 0x2000) >> 10][tileOffset];
+
+        uint16_t tileAddr = patternTableBase + (tileIndex * 16) + row;
+        const uint8_t *pattern = &chr[tileAddr >> 10][tileAddr & 0x3FF]; // Both planes share a page
+        uint8_t plane1 = pattern[0];
+        uint8_t plane2 = pattern[8];
+
+        for (int col = 0; col < 8; ++col)
         {
-            uint16_t tileAddr = resolveNametableAddress(nametableBase + (tileY * 32) + tileX);
-            uint8_t tileIndex = memory[tileAddr];
+            uint8_t pixel = ((plane1 >> (7 - col)) & 1) | (((plane2 >> (7 - col)) & 1) << 1);
+            pixels[tile * 8 + col] = pixel ? paletteBase | pixel : 0;
+        }
+    }
+
+    const uint8_t *visible = pixels + (state.scrollX & 7);
+    for (int x = 0; x < screenWidth; ++x)
+    {
+        line[x] = palette[visible[x]];
+        opaque[x] = visible[x] != 0;
+    }
+
+    // PPUMASK bit 1 clear: the left 8 pixels show the backdrop
+    if (!(state.mask & 0x02))
+    {
+        std::memset(line, palette[0], 8);
+        std::memset(opaque, 0, 8);
+    }
+}
+
+// Build the secondary OAM of every scanline in one pass over OAM. The result only depends on
+// OAM and the sprite size, so it is reused until either changes ($2004, $4014, PPUCTRL bit 5
+// or invalidateSpriteCache()).
+void PPU::evaluateSprites()
+{
+    if (!oamDirty)
+        return;
+
+    const int spriteHeight = (PPUCTRL & 0x20) ? 16 : 8;
 
-            for (int row = 0; row < 8; ++row)
+    for (SpriteLine &line : spriteLines)
+    {
+        line.count = 0;
+        line.overflow = false;
+        line.hasSpriteZero = false;
+    }
+
+    for (int i = 0; i < 64; ++i)
+    {
+        int top = oam[i * 4] + 1; // Sprites are drawn one line below their OAM Y
+        for (int scanline = top; scanline < top + spriteHeight && scanline < 240; ++scanline)
+        {
+            SpriteLine &line = spriteLines[scanline];
+            if (line.count == 8)
             {
-                uint8_t plane1 = memory[patternTableBase + (tileIndex * 16) + row];
-                uint8_t plane2 = memory[patternTableBase + (tileIndex * 16) + row + 8];
-
-                for (int col = 0; col < 8; ++col)
-                {
-                    uint8_t pixel = ((plane1 >> (7 - col)) & 1) | (((plane2 >> (7 - col)) & 1) << 1);
-                    uint8_t color = pixel * 85; // Grayscale for simplicity
-
-                    int screenX = (tileX * 8 + col) % screenWidth;
-                    int screenY = (tileY * 8 + row) % screenHeight;
-
-                    if (screenX >= 0 && screenY >= 0 && screenX < screenWidth && screenY < screenHeight)
-                    {
-                        framebuffer[screenY * screenWidth + screenX] =
-                            (color << 16) | (color << 8) | color; // Set pixel color
-                    }
-                }
+                line.overflow = true; // Ninth sprite in range
+                continue;
             }
+            if (i == 0)
+                line.hasSpriteZero = true;
+            std::memcpy(&line.oam[line.count * 4], &oam[i * 4], 4);
+            ++line.count;
         }
     }
-}
 
+    oamDirty = false;
+}
 
 void PPU::renderSprites()
 {
-    const uint16_t patternTableBase = (PPUCTRL & 0x08) ? 0x1000 : 0x0000;
+    captureFrameState(true);
+    for (int scanline = 0; scanline < 240; ++scanline)
+    {
+        drawSpriteLine(scanline);
+        hashLine(scanline);
+    }
+}
+
+// Draw the sprites of one scanline into a line buffer, then composite it over the background.
+// Line buffer entries hold the sprite palette entry (bits 0-4, zero when transparent) and the
+// behind-background flag (bit 5).
+void PPU::drawSpriteLine(int scanline)
+{
     const int screenWidth = 256;
-    const int screenHeight = 240;
+    const ScanlineState &state = frameState.scanlines[scanline];
+    const SpriteLine &sprites = frameState.spriteLines[scanline];
+    const uint8_t *vram = frameState.memory.data();
+    const ChrPages &chr = frameState.chrPages[scanline];
 
-    for (int i = 0; i < 64; ++i)
-    {
-        int spriteIndex = i * 4;
-        uint8_t y = oam[spriteIndex] + 1;          // Y-coordinate
-        uint8_t tileIndex = oam[spriteIndex + 1];  // Tile index
-        uint8_t attributes = oam[spriteIndex + 2]; // Sprite attributes
-        uint8_t x = oam[spriteIndex + 3];          // X-coordinate
+    if (sprites.count == 0 || !(state.mask & 0x10))
+        return; // No sprites in range, or sprites hidden by PPUMASK bit 4
+
+    const int spriteHeight = (state.ctrl & 0x20) ? 16 : 8;
 
-        bool flipHorizontal = attributes & 0x40;
-        bool flipVertical = attributes & 0x80;
+    std::array<uint8_t, 256 + 8> spriteLine{}; // Padded so sprites at x > 248 need no bounds check
 
-        for (int row = 0; row < 8; ++row)
+    // Walk the secondary OAM back to front so lower OAM indices win; priority between sprites
+    // is resolved before background priority, as on hardware
+    for (int i = sprites.count - 1; i >= 0; --i)
+    {
+        const uint8_t *entry = &sprites.oam[i * 4];
+        uint8_t attributes = entry[2];
+        int x = entry[3];
+
+        int row = scanline - (entry[0] + 1);
+        if (attributes & 0x80)
+            row = spriteHeight - 1 - row; // Vertical flip covers the whole sprite
+
+        uint16_t tileAddr = spritePatternAddress(state.ctrl, entry[1], row);
+        const uint8_t *pattern = &chr[tileAddr >> 10][tileAddr & 0x3FF];
+        uint8_t plane1 = pattern[0];
+        uint8_t plane2 = pattern[8];
+        if (attributes & 0x40)
         {
-            uint8_t plane1 = memory[patternTableBase + (tileIndex * 16) + row];
-            uint8_t plane2 = memory[patternTableBase + (tileIndex * 16) + row + 8];
+            plane1 = reverseBits(plane1); // Horizontal flip
+            plane2 = reverseBits(plane2);
+        }
 
-            for (int col = 0; col < 8; ++col)
-            {
-                uint8_t pixel = ((plane1 >> (7 - col)) & 1) | (((plane2 >> (7 - col)) & 1) << 1);
-                if (pixel == 0)
-                    continue; // Transparent pixel
+        uint8_t flags = 0x10 | ((attributes & 0x03) << 2) | ((attributes & 0x20) ? 0x20 : 0);
 
-                int finalCol = flipHorizontal ? 7 - col : col;
-                int finalRow = flipVertical ? 7 - row : row;
+        uint8_t *out = &spriteLine[x];
+        for (int col = 0; col < 8; ++col)
+        {
+            uint8_t pixel = ((plane1 >> (7 - col)) & 1) | (((plane2 >> (7 - col)) & 1) << 1);
+            out[col] = pixel ? (flags | pixel) : out[col];
+        }
+    }
 
-                int screenX = x + finalCol;
-                int screenY = y + finalRow;
+    uint8_t *line = &framebuffer[scanline * screenWidth];
+    const uint8_t *opaque = &backgroundOpaque[scanline * screenWidth];
 
-                if (screenX >= 0 && screenX < screenWidth && screenY >= 0 && screenY < screenHeight)
-                {
-                    framebuffer[screenY * screenWidth + screenX] = 0xFFFFFF; // White for sprite pixels
-                }
-            }
-        }
+    // Greyscale mode keeps only the luminance column of the palette
+    const uint8_t colorMask = (state.mask & 0x01) ? 0x30 : 0x3F;
+    uint8_t palette[32];
+    for (int i = 0; i < 32; ++i)
+    {
+        palette[i] = paletteEntry(vram, i) & colorMask;
+    }
+
+    // A sprite pixel shows when it is opaque, unless it is behind an opaque background pixel.
+    // PPUMASK bit 2 clear hides sprites in the left 8 pixels.
+    const int firstX = (state.mask & 0x04) ? 0 : 8;
+    for (int x = firstX; x < screenWidth; ++x)
+    {
+        uint8_t sprite = spriteLine[x];
+        bool visible = (sprite & 0x03) && !((sprite & 0x20) && opaque[x]);
+        line[x] = visible ? palette[sprite & 0x1F] : line[x];
     }
 }
 
@@ -278,29 +867,91 @@ void PPU::writeDMA(uint8_t value)
     uint16_t baseAddress = value * 0x100; // Calculate base address
     for (int i = 0; i < 256; i++)
     {
-        oam[i] = cpu->readMemory(baseAddress + i); // Copy byte-by-byte from CPU memory
+        // Copy byte-by-byte from CPU memory through OAMDATA, starting at OAMADDR
+        uint8_t data = cpu->readMemory(baseAddress + i);
+        oam[(OAMADDR + i) & 0xFF] = data;
+        if (!writeLog.empty())
+            logAccess(RegisterAccess::Write, 0x04, data);
     }
+    oamDirty = true;
     std::cerr << "[PPU Debug] OAM DMA Transfer complete. Source: 0x" << std::hex << baseAddress << std::endl;
 }
 
 uint16_t PPU::resolveNametableAddress(uint16_t address)
 {
-    if (address >= 0x2000 && address < 0x3000)
+    if (address >= 0x3F00)
     {
-        uint16_t offset = (address - 0x2000) % 0x1000;
-        if (offset >= 0x800)
-        { // Bottom half mirrors top
-            // std::cerr << "[PPU Debug] Resolving nametable address: 0x" << std::hex << address
-            //           << " -> 0x" << 0x2000 + (offset - 0x800) << std::endl;
-            return 0x2000 + (offset - 0x800);
-        }
-        // std::cerr << "[PPU Debug] Resolving nametable address: 0x" << std::hex << address
-        //           << " -> 0x" << 0x2000 + offset << std::endl;
-        return 0x2000 + offset;
+        // Palette RAM: 32 bytes mirrored up to $3FFF, with $3F10/$3F14/$3F18/$3F1C
+        // mirroring the backdrop entries $3F00/$3F04/$3F08/$3F0C
+        address = 0x3F00 | (address & 0x1F);
+        if ((address & 0x13) == 0x10)
+            address &= ~0x10;
+        return address;
+    }
+
+    if (address >= 0x2000 && address < 0x3F00)
+    {
+        // $3000-$3EFF mirrors $2000-$2EFF
+        const uint8_t *page = nametableSlots[(address >> 10) & 3];
+        return 0x2000 + static_cast<uint16_t>(page - &memory[0x2000]) + (address & 0x3FF);
     }
     return address; // Not a nametable address
 }
 
+void PPU::setMirroring(Mirroring mode)
+{
+    static const uint8_t pageMap[5][4] = {
+        {0, 0, 1, 1}, // Horizontal
+        {0, 1, 0, 1}, // Vertical
+        {0, 0, 0, 0}, // SingleScreenA
+        {1, 1, 1, 1}, // SingleScreenB
+        {0, 1, 2, 3}, // FourScreen
+    };
+
+    mirroring = mode;
+    for (int slot = 0; slot < 4; ++slot)
+    {
+        nametableSlots[slot] = &memory[0x2000 + pageMap[static_cast<int>(mode)][slot] * 0x400];
+    }
+}
+
+// One attribute byte selects the palettes of a 4x4 tile area: bits 0-1 top left 2x2 tiles,
+// 2-3 top right, 4-5 bottom left, 6-7 bottom right
+void PPU::updateAttribute(int page, int index, uint8_t value)
+{
+    int top = (index >> 3) * 4;
+    int left = (index & 7) * 4;
+
+    for (int quadrant = 0; quadrant < 4; ++quadrant)
+    {
+        uint8_t base = ((value >> (quadrant * 2)) & 0x03) * 4;
+        int tileY = top + (quadrant >> 1) * 2;
+        int tileX = left + (quadrant & 1) * 2;
+        for (int y = tileY; y < tileY + 2 && y < 30; ++y) // The last attribute row covers 2 tile rows
+        {
+            attributeCache[page][y * 32 + tileX] = base;
+            attributeCache[page][y * 32 + tileX + 1] = base;
+        }
+    }
+}
+
+void PPU::rebuildAttributeCache()
+{
+    for (int page = 0; page < 4; ++page)
+    {
+        for (int index = 0; index < 64; ++index)
+        {
+            updateAttribute(page, index, memory[0x2000 + page * 0x400 + 0x3C0 + index]);
+        }
+    }
+    attributesDirty = false;
+}
+
+uint8_t PPU::readPalette(uint8_t entry) const
+{
+    return paletteEntry(memory.data(), entry);
+}
+
 void PPU::debugPatternTable()
 {
     for (uint16_t i = 0x0000; i < 0x2000; i += 16)
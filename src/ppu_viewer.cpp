@@ -0,0 +1,138 @@
+#include "ppu.h"
+#include "palette.h"
+
+// Debug viewers. They read the live PPU state, so call them from the thread that runs the
+// emulation (between frames) to see a consistent picture.
+
+namespace
+{
+    uint32_t *rowAt(uint32_t *output, int pitch, int y)
+    {
+        return reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(output) + y * pitch);
+    }
+
+    // 2-bit pixel of one tile row
+    int tilePixel(const PPU &ppu, uint16_t rowAddress, int x)
+    {
+        const uint8_t *pattern = ppu.patternData(rowAddress);
+        int bit = 7 - x;
+        return ((pattern[0] >> bit) & 1) | (((pattern[8] >> bit) & 1) << 1);
+    }
+}
+
+void PPU::viewPatternTables(uint32_t *output, int pitch, uint8_t palette) const
+{
+    const uint32_t *colors = paletteARGB(PPUMASK >> 5);
+    uint8_t base = (palette & 0x07) * 4;
+
+    for (int y = 0; y < PATTERN_VIEW_HEIGHT; ++y)
+    {
+        uint32_t *out = rowAt(output, pitch, y);
+        for (int x = 0; x < PATTERN_VIEW_WIDTH; ++x)
+        {
+            // Table 0 on the left, table 1 on the right, 16x16 tiles each
+            int table = x >> 7;
+            int tile = ((y >> 3) << 4) | ((x & 0x7F) >> 3);
+            int pixel = tilePixel(*this, table * 0x1000 + tile * 16 + (y & 7), x & 7);
+            out[x] = colors[readPalette(pixel ? base + pixel : 0) & 0x3F];
+        }
+    }
+}
+
+void PPU::viewNametables(uint32_t *output, int pitch, bool scrollWindow) const
+{
+    const uint32_t *colors = paletteARGB(PPUMASK >> 5);
+    uint16_t patternBase = (PPUCTRL & 0x10) ? 0x1000 : 0x0000;
+
+    for (int y = 0; y < NAMETABLE_VIEW_HEIGHT; ++y)
+    {
+        uint32_t *out = rowAt(output, pitch, y);
+        int ntY = y / 240;
+        int row = y % 240;
+
+        for (int x = 0; x < NAMETABLE_VIEW_WIDTH; ++x)
+        {
+            // The nametable as the CPU sees it through the current mirroring
+            const uint8_t *nametable = nametableSlots[(ntY << 1) | (x >> 8)];
+            int column = (x & 0xFF) >> 3;
+            uint8_t tile = nametable[(row >> 3) * 32 + column];
+            uint8_t attribute = nametable[0x3C0 + (row >> 5) * 8 + (column >> 2)];
+            int shift = ((row >> 4) & 1) * 4 + ((column >> 1) & 1) * 2;
+            int palette = (attribute >> shift) & 0x03;
+
+            int pixel = tilePixel(*this, patternBase + tile * 16 + (row & 7), x & 7);
+            out[x] = colors[readPalette(pixel ? palette * 4 + pixel : 0) & 0x3F];
+        }
+    }
+
+    if (!scrollWindow)
+        return;
+
+    // Outline the visible 256x240 window at the current scroll, wrapping around the edges
+    int left = (PPUCTRL & 0x01) * 256 + fineXScroll;
+    int top = ((PPUCTRL >> 1) & 0x01) * 240 + fineYScroll;
+    for (int i = 0; i < 256; ++i)
+    {
+        int x = (left + i) % NAMETABLE_VIEW_WIDTH;
+        rowAt(output, pitch, top % NAMETABLE_VIEW_HEIGHT)[x] ^= 0x00FFFFFF;
+        rowAt(output, pitch, (top + 239) % NAMETABLE_VIEW_HEIGHT)[x] ^= 0x00FFFFFF;
+    }
+    for (int i = 1; i < 239; ++i)
+    {
+        uint32_t *out = rowAt(output, pitch, (top + i) % NAMETABLE_VIEW_HEIGHT);
+        out[left % NAMETABLE_VIEW_WIDTH] ^= 0x00FFFFFF;
+        out[(left + 255) % NAMETABLE_VIEW_WIDTH] ^= 0x00FFFFFF;
+    }
+}
+
+void PPU::viewSprites(uint32_t *output, int pitch) const
+{
+    const uint32_t *colors = paletteARGB(PPUMASK >> 5);
+    uint32_t backdrop = colors[readPalette(0) & 0x3F];
+    bool tall = PPUCTRL & 0x20;
+
+    for (int y = 0; y < SPRITE_VIEW_HEIGHT; ++y)
+    {
+        uint32_t *out = rowAt(output, pitch, y);
+        int row = y & 15;
+
+        for (int x = 0; x < SPRITE_VIEW_WIDTH; ++x)
+        {
+            int sprite = (y >> 4) * 8 + (x >> 3);
+            uint8_t tile = oam[sprite * 4 + 1];
+            uint8_t attributes = oam[sprite * 4 + 2];
+            int height = tall ? 16 : 8;
+            if (row >= height)
+            {
+                out[x] = backdrop;
+                continue;
+            }
+
+            int spriteRow = (attributes & 0x80) ? height - 1 - row : row;
+            int column = (attributes & 0x40) ? 7 - (x & 7) : (x & 7);
+            uint16_t address;
+            if (tall)
+                address = (tile & 0x01) * 0x1000 + ((tile & 0xFE) + (spriteRow >> 3)) * 16 + (spriteRow & 7);
+            else
+                address = ((PPUCTRL & 0x08) ? 0x1000 : 0x0000) + tile * 16 + spriteRow;
+
+            int pixel = tilePixel(*this, address, column);
+            out[x] = pixel ? colors[readPalette(0x10 + (attributes & 0x03) * 4 + pixel) & 0x3F] : backdrop;
+        }
+    }
+}
+
+void PPU::viewPalettes(uint32_t *output, int pitch) const
+{
+    const uint32_t *colors = paletteARGB(PPUMASK >> 5);
+
+    for (int y = 0; y < PALETTE_VIEW_HEIGHT; ++y)
+    {
+        uint32_t *out = rowAt(output, pitch, y);
+        for (int x = 0; x < PALETTE_VIEW_WIDTH; ++x)
+        {
+            int entry = (y >> 4) * 16 + (x >> 4);
+            out[x] = colors[readPalette(entry) & 0x3F];
+        }
+    }
+}
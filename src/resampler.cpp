@@ -0,0 +1,123 @@
+#include "resampler.h"
+#include <algorithm> // For std::min, std::max
+#include <array>
+#include <cmath>
+
+namespace
+{
+    const int FRAC_BITS = 32;
+    const int COEFFICIENT_BITS = 14; // Each kernel phase sums to 1 << COEFFICIENT_BITS
+    const double SMOOTHING = 0.05;   // Weight of the newest queue depth in the running average
+
+    using Kernel = std::array<std::array<int16_t, Resampler::TAPS>, Resampler::PHASES>;
+
+    // Windowed-sinc interpolation kernel. Output sample position TAPS / 2 - 1 + phase / PHASES
+    // within the taps; each phase is normalised so a constant input stays constant.
+    Kernel buildKernel()
+    {
+        const double pi = 3.14159265358979323846;
+        const double cutoff = 0.45; // Of the input sample rate
+        const double half = Resampler::TAPS / 2;
+
+        Kernel kernel;
+        for (int phase = 0; phase < Resampler::PHASES; ++phase)
+        {
+            double taps[Resampler::TAPS];
+            double sum = 0.0;
+            for (int k = 0; k < Resampler::TAPS; ++k)
+            {
+                double x = k - (half - 1) - static_cast<double>(phase) / Resampler::PHASES;
+                double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * pi * cutoff * x) / (2.0 * pi * cutoff * x);
+                double window = 0.5 + 0.5 * std::cos(pi * x / half); // Hann
+                taps[k] = sinc * window;
+                sum += taps[k];
+            }
+
+            int total = 0;
+            int largest = 0;
+            for (int k = 0; k < Resampler::TAPS; ++k)
+            {
+                kernel[phase][k] = static_cast<int16_t>(std::lround(taps[k] / sum * (1 << COEFFICIENT_BITS)));
+                total += kernel[phase][k];
+                if (kernel[phase][k] > kernel[phase][largest])
+                    largest = k;
+            }
+            kernel[phase][largest] += (1 << COEFFICIENT_BITS) - total;
+        }
+        return kernel;
+    }
+
+    const Kernel &interpolationKernel()
+    {
+        static const Kernel kernel = buildKernel();
+        return kernel;
+    }
+}
+
+Resampler::Resampler()
+{
+    interpolationKernel();
+    setRatio(1.0);
+    reset();
+}
+
+void Resampler::reset()
+{
+    pending.assign(TAPS - 1, 0);
+    position = 0;
+}
+
+void Resampler::setRatio(double newRatio)
+{
+    ratio = newRatio;
+    step = static_cast<uint64_t>(std::llround(4294967296.0 / ratio));
+}
+
+size_t Resampler::process(const int16_t *in, size_t count, int16_t *out, size_t outCapacity)
+{
+    pending.insert(pending.end(), in, in + count);
+
+    const Kernel &kernel = interpolationKernel();
+    size_t written = 0;
+    while (written < outCapacity)
+    {
+        size_t index = static_cast<size_t>(position >> FRAC_BITS);
+        if (index + TAPS > pending.size())
+            break;
+
+        const int16_t *taps = kernel[(position >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1)].data();
+        const int16_t *samples = &pending[index];
+        int32_t sum = 0;
+        for (int k = 0; k < TAPS; ++k)
+        {
+            sum += samples[k] * taps[k];
+        }
+        sum = (sum + (1 << (COEFFICIENT_BITS - 1))) >> COEFFICIENT_BITS;
+        out[written++] = static_cast<int16_t>(std::max(-32768, std::min(32767, sum)));
+        position += step;
+    }
+
+    // Drop the input every later output has moved past
+    size_t consumed = std::min(static_cast<size_t>(position >> FRAC_BITS), pending.size());
+    pending.erase(pending.begin(), pending.begin() + consumed);
+    position -= static_cast<uint64_t>(consumed) << FRAC_BITS;
+    return written;
+}
+
+RateControl::RateControl(double targetSamples, double maxDeviation)
+    : target(targetSamples), maxDeviation(maxDeviation), smoothed(targetSamples), started(false)
+{
+}
+
+double RateControl::update(size_t queuedSamples)
+{
+    if (!started)
+    {
+        smoothed = static_cast<double>(queuedSamples);
+        started = true;
+    }
+    smoothed += (static_cast<double>(queuedSamples) - smoothed) * SMOOTHING;
+
+    double error = (target - smoothed) / target; // Positive when the queue is too shallow
+    return 1.0 + std::max(-1.0, std::min(1.0, error)) * maxDeviation;
+}
@@ -0,0 +1,342 @@
+#include "scaler.h"
+#include "worker_pool.h"
+#include <cstring> // For memcpy
+#include <vector>
+
+// The inner loops are written without branches or clamped indices so the compiler can
+// vectorise them; the Makefile builds this file with -O3 for that reason.
+
+namespace
+{
+    template <typename Pixel>
+    const Pixel *rowAt(const Pixel *base, int pitch, int y)
+    {
+        return reinterpret_cast<const Pixel *>(reinterpret_cast<const uint8_t *>(base) + y * pitch);
+    }
+
+    template <typename Pixel>
+    Pixel *rowAt(Pixel *base, int pitch, int y)
+    {
+        return reinterpret_cast<Pixel *>(reinterpret_cast<uint8_t *>(base) + y * pitch);
+    }
+
+    // Run task over the source rows, split into bands on the pool if there is one
+    void forRows(WorkerPool *pool, int height, const WorkerPool::Task &task)
+    {
+        if (pool)
+            pool->parallelFor(height, task);
+        else
+            task(0, height);
+    }
+
+    template <int Factor, typename Pixel>
+    void expandRow(const Pixel *in, int width, Pixel *out)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            for (int k = 0; k < Factor; ++k)
+            {
+                out[x * Factor + k] = in[x];
+            }
+        }
+    }
+
+    template <typename Pixel>
+    void expandRow(const Pixel *in, int width, int factor, Pixel *out)
+    {
+        switch (factor)
+        {
+        case 2:
+            expandRow<2>(in, width, out);
+            break;
+        case 3:
+            expandRow<3>(in, width, out);
+            break;
+        case 4:
+            expandRow<4>(in, width, out);
+            break;
+        default:
+            for (int x = 0; x < width; ++x)
+            {
+                for (int k = 0; k < factor; ++k)
+                {
+                    out[x * factor + k] = in[x];
+                }
+            }
+            break;
+        }
+    }
+
+    // Scale2x on one source pixel E with neighbours B (up), D (left), F (right), H (down)
+    template <typename Pixel>
+    inline void scale2xPixel(Pixel b, Pixel d, Pixel e, Pixel f, Pixel h, Pixel *out0, Pixel *out1)
+    {
+        bool edge = b != h && d != f;
+        out0[0] = (edge && d == b) ? d : e;
+        out0[1] = (edge && b == f) ? f : e;
+        out1[0] = (edge && d == h) ? d : e;
+        out1[1] = (edge && h == f) ? f : e;
+    }
+
+    template <typename Pixel>
+    void scale2xRow(const Pixel *up, const Pixel *mid, const Pixel *down, int width,
+                    Pixel *out0, Pixel *out1)
+    {
+        if (width == 1)
+        {
+            scale2xPixel(up[0], mid[0], mid[0], mid[0], down[0], out0, out1);
+            return;
+        }
+
+        // Edge columns repeat their own pixel as the missing neighbour
+        scale2xPixel(up[0], mid[0], mid[0], mid[1], down[0], out0, out1);
+        for (int x = 1; x < width - 1; ++x)
+        {
+            scale2xPixel(up[x], mid[x - 1], mid[x], mid[x + 1], down[x], out0 + x * 2, out1 + x * 2);
+        }
+        int last = width - 1;
+        scale2xPixel(up[last], mid[last - 1], mid[last], mid[last], down[last],
+                     out0 + last * 2, out1 + last * 2);
+    }
+
+    // Scale3x on one source pixel E with its 3x3 neighbourhood A B C / D E F / G H I
+    template <typename Pixel>
+    inline void scale3xPixel(Pixel a, Pixel b, Pixel c, Pixel d, Pixel e, Pixel f,
+                             Pixel g, Pixel h, Pixel i, Pixel *out0, Pixel *out1, Pixel *out2)
+    {
+        bool edge = b != h && d != f;
+        bool db = edge && d == b;
+        bool bf = edge && b == f;
+        bool dh = edge && d == h;
+        bool hf = edge && h == f;
+
+        out0[0] = db ? d : e;
+        out0[1] = ((db && e != c) || (bf && e != a)) ? b : e;
+        out0[2] = bf ? f : e;
+        out1[0] = ((db && e != g) || (dh && e != a)) ? d : e;
+        out1[1] = e;
+        out1[2] = ((bf && e != i) || (hf && e != c)) ? f : e;
+        out2[0] = dh ? d : e;
+        out2[1] = ((dh && e != i) || (hf && e != g)) ? h : e;
+        out2[2] = hf ? f : e;
+    }
+
+    template <typename Pixel>
+    void scale3xRow(const Pixel *up, const Pixel *mid, const Pixel *down, int width,
+                    Pixel *out0, Pixel *out1, Pixel *out2)
+    {
+        if (width == 1)
+        {
+            scale3xPixel(up[0], up[0], up[0], mid[0], mid[0], mid[0], down[0], down[0], down[0],
+                         out0, out1, out2);
+            return;
+        }
+
+        scale3xPixel(up[0], up[0], up[1], mid[0], mid[0], mid[1], down[0], down[0], down[1],
+                     out0, out1, out2);
+        for (int x = 1; x < width - 1; ++x)
+        {
+            scale3xPixel(up[x - 1], up[x], up[x + 1], mid[x - 1], mid[x], mid[x + 1],
+                         down[x - 1], down[x], down[x + 1], out0 + x * 3, out1 + x * 3, out2 + x * 3);
+        }
+        int last = width - 1;
+        scale3xPixel(up[last - 1], up[last], up[last], mid[last - 1], mid[last], mid[last],
+                     down[last - 1], down[last], down[last], out0 + last * 3, out1 + last * 3, out2 + last * 3);
+    }
+
+    // hq2x colour space: Y, U and V packed into the low three bytes
+    uint32_t toYUV(uint32_t argb)
+    {
+        int r = (argb >> 16) & 0xFF;
+        int g = (argb >> 8) & 0xFF;
+        int b = argb & 0xFF;
+        int y = (r + g + b) >> 2;
+        int u = 128 + ((r - b) >> 2);
+        int v = 128 + ((-r + 2 * g - b) >> 3);
+        return static_cast<uint32_t>((y << 16) | (u << 8) | v);
+    }
+
+    // hq2x similarity thresholds: Y 48, U 7, V 6
+    bool similar(uint32_t yuv1, uint32_t yuv2)
+    {
+        int dy = static_cast<int>((yuv1 >> 16) & 0xFF) - static_cast<int>((yuv2 >> 16) & 0xFF);
+        int du = static_cast<int>((yuv1 >> 8) & 0xFF) - static_cast<int>((yuv2 >> 8) & 0xFF);
+        int dv = static_cast<int>(yuv1 & 0xFF) - static_cast<int>(yuv2 & 0xFF);
+        return dy <= 48 && dy >= -48 && du <= 7 && du >= -7 && dv <= 6 && dv >= -6;
+    }
+
+    // Weighted mix of three ARGB colours, weights summing to 8; alpha comes from the first
+    uint32_t blend(uint32_t e, uint32_t we, uint32_t x, uint32_t wx, uint32_t y, uint32_t wy)
+    {
+        uint32_t rb = (((e & 0xFF00FF) * we + (x & 0xFF00FF) * wx + (y & 0xFF00FF) * wy) >> 3) & 0xFF00FF;
+        uint32_t g = (((e & 0x00FF00) * we + (x & 0x00FF00) * wx + (y & 0x00FF00) * wy) >> 3) & 0x00FF00;
+        return (e & 0xFF000000) | rb | g;
+    }
+
+    // One output quadrant of pixel E, next to the edge neighbours X and Y and the corner
+    // neighbour C between them
+    uint32_t hqQuadrant(uint32_t e, uint32_t x, uint32_t y,
+                        uint32_t yuvE, uint32_t yuvX, uint32_t yuvY, uint32_t yuvC)
+    {
+        bool diffX = !similar(yuvE, yuvX);
+        bool diffY = !similar(yuvE, yuvY);
+
+        if (diffX && diffY)
+        {
+            // A diagonal edge cuts the corner when X and Y match; a thin line passes through
+            // it when the corner still matches E
+            if (similar(yuvX, yuvY))
+                return similar(yuvE, yuvC) ? blend(e, 4, x, 2, y, 2) : blend(e, 2, x, 3, y, 3);
+            return blend(e, 4, x, 2, y, 2);
+        }
+        if (diffX)
+            return blend(e, 6, x, 2, y, 0);
+        if (diffY)
+            return blend(e, 6, x, 0, y, 2);
+        return e;
+    }
+}
+
+int scaleFactor(ScaleFilter filter, int nearestFactor)
+{
+    switch (filter)
+    {
+    case ScaleFilter::Scale2x:
+    case ScaleFilter::HQ2x:
+        return 2;
+    case ScaleFilter::Scale3x:
+        return 3;
+    case ScaleFilter::Nearest:
+    default:
+        return nearestFactor;
+    }
+}
+
+template <typename Pixel>
+void scaleNearest(const Pixel *src, int srcPitch, int width, int height, int factor,
+                  Pixel *dst, int dstPitch, WorkerPool *pool)
+{
+    forRows(pool, height, [=](int begin, int end)
+            {
+                for (int y = begin; y < end; ++y)
+                {
+                    // Expand the row once, then copy it to the remaining output rows
+                    Pixel *out = rowAt(dst, dstPitch, y * factor);
+                    expandRow(rowAt(src, srcPitch, y), width, factor, out);
+                    for (int k = 1; k < factor; ++k)
+                    {
+                        memcpy(rowAt(dst, dstPitch, y * factor + k), out, width * factor * sizeof(Pixel));
+                    }
+                } });
+}
+
+template <typename Pixel>
+void scale2x(const Pixel *src, int srcPitch, int width, int height,
+             Pixel *dst, int dstPitch, WorkerPool *pool)
+{
+    forRows(pool, height, [=](int begin, int end)
+            {
+                for (int y = begin; y < end; ++y)
+                {
+                    const Pixel *up = rowAt(src, srcPitch, y > 0 ? y - 1 : y);
+                    const Pixel *down = rowAt(src, srcPitch, y < height - 1 ? y + 1 : y);
+                    scale2xRow(up, rowAt(src, srcPitch, y), down, width,
+                               rowAt(dst, dstPitch, y * 2), rowAt(dst, dstPitch, y * 2 + 1));
+                } });
+}
+
+template <typename Pixel>
+void scale3x(const Pixel *src, int srcPitch, int width, int height,
+             Pixel *dst, int dstPitch, WorkerPool *pool)
+{
+    forRows(pool, height, [=](int begin, int end)
+            {
+                for (int y = begin; y < end; ++y)
+                {
+                    const Pixel *up = rowAt(src, srcPitch, y > 0 ? y - 1 : y);
+                    const Pixel *down = rowAt(src, srcPitch, y < height - 1 ? y + 1 : y);
+                    scale3xRow(up, rowAt(src, srcPitch, y), down, width, rowAt(dst, dstPitch, y * 3),
+                               rowAt(dst, dstPitch, y * 3 + 1), rowAt(dst, dstPitch, y * 3 + 2));
+                } });
+}
+
+// hq2x with its YUV similarity test and a condensed set of its interpolation rules in place
+// of the full 256-pattern case table
+void hq2x(const uint32_t *src, int srcPitch, int width, int height,
+          uint32_t *dst, int dstPitch, WorkerPool *pool)
+{
+    forRows(pool, height, [=](int begin, int end)
+            {
+                // YUV of the band plus one row above and below, reused across frames
+                thread_local std::vector<uint32_t> yuv;
+                int first = begin > 0 ? begin - 1 : 0;
+                int last = end < height ? end : height - 1;
+                yuv.resize(static_cast<size_t>(last - first + 1) * width);
+                for (int y = first; y <= last; ++y)
+                {
+                    const uint32_t *in = rowAt(src, srcPitch, y);
+                    uint32_t *out = &yuv[static_cast<size_t>(y - first) * width];
+                    for (int x = 0; x < width; ++x)
+                    {
+                        out[x] = toYUV(in[x]);
+                    }
+                }
+
+                for (int y = begin; y < end; ++y)
+                {
+                    int yUp = y > 0 ? y - 1 : y;
+                    int yDown = y < height - 1 ? y + 1 : y;
+                    const uint32_t *up = rowAt(src, srcPitch, yUp);
+                    const uint32_t *mid = rowAt(src, srcPitch, y);
+                    const uint32_t *down = rowAt(src, srcPitch, yDown);
+                    const uint32_t *yuvUp = &yuv[static_cast<size_t>(yUp - first) * width];
+                    const uint32_t *yuvMid = &yuv[static_cast<size_t>(y - first) * width];
+                    const uint32_t *yuvDown = &yuv[static_cast<size_t>(yDown - first) * width];
+                    uint32_t *out0 = rowAt(dst, dstPitch, y * 2);
+                    uint32_t *out1 = rowAt(dst, dstPitch, y * 2 + 1);
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        int l = x > 0 ? x - 1 : x;
+                        int r = x < width - 1 ? x + 1 : x;
+                        uint32_t e = mid[x];
+
+                        out0[x * 2] = hqQuadrant(e, up[x], mid[l], yuvMid[x], yuvUp[x], yuvMid[l], yuvUp[l]);
+                        out0[x * 2 + 1] = hqQuadrant(e, up[x], mid[r], yuvMid[x], yuvUp[x], yuvMid[r], yuvUp[r]);
+                        out1[x * 2] = hqQuadrant(e, down[x], mid[l], yuvMid[x], yuvDown[x], yuvMid[l], yuvDown[l]);
+                        out1[x * 2 + 1] = hqQuadrant(e, down[x], mid[r], yuvMid[x], yuvDown[x], yuvMid[r], yuvDown[r]);
+                    }
+                } });
+}
+
+void scaleFrame(ScaleFilter filter, const uint32_t *src, int srcPitch, int width, int height,
+                int nearestFactor, uint32_t *dst, int dstPitch, WorkerPool *pool)
+{
+    switch (filter)
+    {
+    case ScaleFilter::Scale2x:
+        scale2x(src, srcPitch, width, height, dst, dstPitch, pool);
+        break;
+    case ScaleFilter::Scale3x:
+        scale3x(src, srcPitch, width, height, dst, dstPitch, pool);
+        break;
+    case ScaleFilter::HQ2x:
+        hq2x(src, srcPitch, width, height, dst, dstPitch, pool);
+        break;
+    case ScaleFilter::Nearest:
+    default:
+        scaleNearest(src, srcPitch, width, height, nearestFactor, dst, dstPitch, pool);
+        break;
+    }
+}
+
+// Pixel formats of palette.h: indices, RGB565 and ARGB8888
+template void scaleNearest<uint8_t>(const uint8_t *, int, int, int, int, uint8_t *, int, WorkerPool *);
+template void scaleNearest<uint16_t>(const uint16_t *, int, int, int, int, uint16_t *, int, WorkerPool *);
+template void scaleNearest<uint32_t>(const uint32_t *, int, int, int, int, uint32_t *, int, WorkerPool *);
+template void scale2x<uint8_t>(const uint8_t *, int, int, int, uint8_t *, int, WorkerPool *);
+template void scale2x<uint16_t>(const uint16_t *, int, int, int, uint16_t *, int, WorkerPool *);
+template void scale2x<uint32_t>(const uint32_t *, int, int, int, uint32_t *, int, WorkerPool *);
+template void scale3x<uint8_t>(const uint8_t *, int, int, int, uint8_t *, int, WorkerPool *);
+template void scale3x<uint16_t>(const uint16_t *, int, int, int, uint16_t *, int, WorkerPool *);
+template void scale3x<uint32_t>(const uint32_t *, int, int, int, uint32_t *, int, WorkerPool *);
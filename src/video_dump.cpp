@@ -0,0 +1,327 @@
+#include "video_dump.h"
+#include "palette.h"
+#include "ppu.h"
+#include <cstdio>
+#include <cstring> // For memcpy
+
+namespace
+{
+    const int WIDTH = 256;
+    const int HEIGHT = 240;
+    const int BUFFER_COUNT = 8;
+    const size_t BUFFER_CAPACITY = 200 * 1024; // Largest frame: an uncompressed PNG, ~185KB
+
+    // NTSC NES frame rate (39375000 / 655171 = 60.0988 Hz) and 8:7 pixel aspect ratio
+    const char Y4M_HEADER[] = "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7 C420jpeg\n";
+    const char Y4M_FRAME[] = "FRAME\n";
+
+    uint8_t *reserve(AsyncFileWriter::Buffer &buffer, size_t size)
+    {
+        if (buffer.data.size() < size)
+            buffer.data.resize(size);
+        buffer.size = size;
+        return buffer.data.data();
+    }
+
+    // BT.601 studio range RGB to YUV over one row. Plain integer loops the compiler vectorises.
+    void lumaRow(const uint32_t *argb, uint8_t *y, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int r = (argb[x] >> 16) & 0xFF;
+            int g = (argb[x] >> 8) & 0xFF;
+            int b = argb[x] & 0xFF;
+            y[x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    // Chroma of 2x2 blocks from two rows, using the block's average colour
+    void chromaRow(const uint32_t *row0, const uint32_t *row1, uint8_t *u, uint8_t *v, int width)
+    {
+        for (int x = 0; x < width / 2; ++x)
+        {
+            uint32_t p0 = row0[x * 2], p1 = row0[x * 2 + 1], p2 = row1[x * 2], p3 = row1[x * 2 + 1];
+            int r = (((p0 >> 16) & 0xFF) + ((p1 >> 16) & 0xFF) + ((p2 >> 16) & 0xFF) + ((p3 >> 16) & 0xFF) + 2) >> 2;
+            int g = (((p0 >> 8) & 0xFF) + ((p1 >> 8) & 0xFF) + ((p2 >> 8) & 0xFF) + ((p3 >> 8) & 0xFF) + 2) >> 2;
+            int b = ((p0 & 0xFF) + (p1 & 0xFF) + (p2 & 0xFF) + (p3 & 0xFF) + 2) >> 2;
+            u[x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    // PNG chunk checksums
+    uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0)
+    {
+        static const struct CrcTable
+        {
+            uint32_t entries[256];
+            CrcTable()
+            {
+                for (uint32_t n = 0; n < 256; ++n)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                    }
+                    entries[n] = c;
+                }
+            }
+        } table;
+
+        crc = ~crc;
+        for (size_t i = 0; i < length; ++i)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(const uint8_t *data, size_t length, uint32_t adler)
+    {
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while (length > 0)
+        {
+            // Sums stay below 2^32 for 5552 bytes before the modulo is needed
+            size_t block = length < 5552 ? length : 5552;
+            length -= block;
+            for (size_t i = 0; i < block; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            data += block;
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    uint8_t *putBigEndian(uint8_t *p, uint32_t value)
+    {
+        p[0] = static_cast<uint8_t>(value >> 24);
+        p[1] = static_cast<uint8_t>(value >> 16);
+        p[2] = static_cast<uint8_t>(value >> 8);
+        p[3] = static_cast<uint8_t>(value);
+        return p + 4;
+    }
+
+    // Chunk at p with its data already in place after the 8-byte header; returns the end
+    uint8_t *finishChunk(uint8_t *p, const char *type, uint32_t length)
+    {
+        putBigEndian(p, length);
+        memcpy(p + 4, type, 4);
+        return putBigEndian(p + 8 + length, crc32(p + 4, length + 4));
+    }
+}
+
+VideoDump::VideoDump()
+    : writer(BUFFER_COUNT, BUFFER_CAPACITY), format(VideoFormat::Y4M), opened(false),
+      headerWritten(false), frameCount(0)
+{
+}
+
+VideoFormat VideoDump::formatForPath(const std::string &path)
+{
+    auto endsWith = [&path](const char *suffix)
+    {
+        size_t length = strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+
+    if (endsWith(".png"))
+        return VideoFormat::PNG;
+    if (endsWith(".rgb") || endsWith(".raw"))
+        return VideoFormat::RawRGB;
+    return VideoFormat::Y4M;
+}
+
+bool VideoDump::open(const std::string &path, VideoFormat outputFormat)
+{
+    close();
+    format = outputFormat;
+    frameCount = 0;
+    headerWritten = false;
+
+    if (format == VideoFormat::PNG)
+    {
+        pngPrefix = path.size() > 4 && path.compare(path.size() - 4, 4, ".png") == 0
+                        ? path.substr(0, path.size() - 4)
+                        : path;
+        opened = writer.open("");
+    }
+    else
+    {
+        opened = writer.open(path);
+    }
+    return opened;
+}
+
+void VideoDump::close()
+{
+    if (opened)
+    {
+        writer.close();
+        opened = false;
+    }
+}
+
+void VideoDump::writeFrame(const Frame &frame)
+{
+    if (!opened)
+        return;
+
+    convertFrame(frame.pixels.data(), frame.emphasis.data(), WIDTH, HEIGHT, PixelFormat::ARGB8888,
+                 argb.data(), WIDTH * 4);
+
+    AsyncFileWriter::Buffer &buffer = writer.acquire();
+    switch (format)
+    {
+    case VideoFormat::Y4M:
+        encodeY4M(argb.data(), buffer);
+        break;
+    case VideoFormat::RawRGB:
+        encodeRGB(argb.data(), buffer);
+        break;
+    case VideoFormat::PNG:
+        encodePNG(argb.data(), buffer);
+        break;
+    }
+    writer.submit(buffer);
+    ++frameCount;
+}
+
+void VideoDump::encodeY4M(const uint32_t *pixels, AsyncFileWriter::Buffer &buffer)
+{
+    // The stream header goes out with the first frame
+    size_t headerSize = headerWritten ? 0 : sizeof(Y4M_HEADER) - 1;
+    size_t frameSize = sizeof(Y4M_FRAME) - 1 + WIDTH * HEIGHT * 3 / 2;
+    uint8_t *out = reserve(buffer, headerSize + frameSize);
+
+    memcpy(out, Y4M_HEADER, headerSize);
+    out += headerSize;
+    headerWritten = true;
+    memcpy(out, Y4M_FRAME, sizeof(Y4M_FRAME) - 1);
+    out += sizeof(Y4M_FRAME) - 1;
+
+    uint8_t *planeY = out;
+    uint8_t *planeU = planeY + WIDTH * HEIGHT;
+    uint8_t *planeV = planeU + WIDTH * HEIGHT / 4;
+    for (int y = 0; y < HEIGHT; ++y)
+    {
+        lumaRow(pixels + y * WIDTH, planeY + y * WIDTH, WIDTH);
+    }
+    for (int y = 0; y < HEIGHT / 2; ++y)
+    {
+        chromaRow(pixels + y * 2 * WIDTH, pixels + (y * 2 + 1) * WIDTH,
+                  planeU + y * WIDTH / 2, planeV + y * WIDTH / 2, WIDTH);
+    }
+}
+
+void VideoDump::encodeRGB(const uint32_t *pixels, AsyncFileWriter::Buffer &buffer)
+{
+    uint8_t *out = reserve(buffer, WIDTH * HEIGHT * 3);
+    for (int i = 0; i < WIDTH * HEIGHT; ++i)
+    {
+        out[i * 3] = static_cast<uint8_t>(pixels[i] >> 16);
+        out[i * 3 + 1] = static_cast<uint8_t>(pixels[i] >> 8);
+        out[i * 3 + 2] = static_cast<uint8_t>(pixels[i]);
+    }
+}
+
+// Uncompressed PNG: the image data is a zlib stream of stored deflate blocks, which costs no
+// more than a copy and leaves compression to whatever consumes the files
+void VideoDump::encodePNG(const uint32_t *pixels, AsyncFileWriter::Buffer &buffer)
+{
+    const size_t rowSize = 1 + WIDTH * 3; // Filter type byte + RGB
+    const size_t rawSize = rowSize * HEIGHT;
+    const size_t maxBlock = 65535;
+    const size_t blockCount = (rawSize + maxBlock - 1) / maxBlock;
+    const size_t idatSize = 2 + rawSize + blockCount * 5 + 4;
+    const size_t fileSize = 8 + (12 + 13) + (12 + idatSize) + 12;
+
+    uint8_t *start = reserve(buffer, fileSize);
+    uint8_t *p = start;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    memcpy(p, signature, 8);
+    p += 8;
+
+    // IHDR: 8-bit RGB, no interlacing
+    uint8_t *ihdr = p + 8;
+    putBigEndian(ihdr, WIDTH);
+    putBigEndian(ihdr + 4, HEIGHT);
+    ihdr[8] = 8;  // Bit depth
+    ihdr[9] = 2;  // Colour type: truecolour
+    ihdr[10] = 0; // Compression
+    ihdr[11] = 0; // Filter method
+    ihdr[12] = 0; // Interlace
+    p = finishChunk(p, "IHDR", 13);
+
+    // IDAT: zlib header, stored blocks of the filtered rows, Adler-32 of the raw data
+    uint8_t *idat = p + 8;
+    uint8_t *z = idat;
+    *z++ = 0x78;
+    *z++ = 0x01;
+
+    size_t remaining = rawSize;
+    size_t rawOffset = 0;
+    uint8_t row[rowSize];
+    while (remaining > 0)
+    {
+        size_t block = remaining < maxBlock ? remaining : maxBlock;
+        remaining -= block;
+        *z++ = remaining == 0 ? 1 : 0; // BFINAL, BTYPE = stored
+        *z++ = static_cast<uint8_t>(block);
+        *z++ = static_cast<uint8_t>(block >> 8);
+        *z++ = static_cast<uint8_t>(~block);
+        *z++ = static_cast<uint8_t>(~block >> 8);
+
+        // Fill the block from the rows it spans
+        size_t written = 0;
+        while (written < block)
+        {
+            size_t y = rawOffset / rowSize;
+            size_t column = rawOffset % rowSize;
+            if (column == 0)
+            {
+                row[0] = 0; // Filter: none
+                for (int x = 0; x < WIDTH; ++x)
+                {
+                    uint32_t pixel = pixels[y * WIDTH + x];
+                    row[1 + x * 3] = static_cast<uint8_t>(pixel >> 16);
+                    row[2 + x * 3] = static_cast<uint8_t>(pixel >> 8);
+                    row[3 + x * 3] = static_cast<uint8_t>(pixel);
+                }
+            }
+            size_t count = rowSize - column;
+            if (count > block - written)
+                count = block - written;
+            memcpy(z, row + column, count);
+            z += count;
+            written += count;
+            rawOffset += count;
+        }
+    }
+    // Adler-32 over the raw data, skipping the block headers
+    const uint8_t *blockData = idat + 2;
+    uint32_t adler = 1;
+    remaining = rawSize;
+    while (remaining > 0)
+    {
+        size_t block = remaining < maxBlock ? remaining : maxBlock;
+        adler = adler32(blockData + 5, block, adler);
+        blockData += 5 + block;
+        remaining -= block;
+    }
+    z = putBigEndian(z, adler);
+    p = finishChunk(p, "IDAT", static_cast<uint32_t>(z - idat));
+
+    p = finishChunk(p, "IEND", 0);
+    buffer.size = static_cast<size_t>(p - start);
+
+    char name[32];
+    snprintf(name, sizeof(name), "_%06lu.png", frameCount);
+    buffer.path = pngPrefix + name;
+}
@@ -0,0 +1,84 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int threadCount)
+{
+    for (int i = 0; i < threadCount; ++i)
+    {
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this]() { return pending == 0; });
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkerPool::dispatch(int rows, Task job)
+{
+    if (workers.empty())
+    {
+        job(0, rows); // No workers: run inline
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this]() { return pending == 0; });
+        task = std::move(job);
+        count = rows;
+        pending = size();
+        ++generation;
+    }
+    workReady.notify_all();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this]() { return pending == 0; });
+}
+
+void WorkerPool::parallelFor(int rows, Task job)
+{
+    dispatch(rows, std::move(job));
+    wait();
+}
+
+void WorkerPool::workerLoop(int index)
+{
+    unsigned seenGeneration = 0;
+
+    while (true)
+    {
+        int begin, end;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+
+            // Band boundaries: band i covers rows [count * i / n, count * (i + 1) / n)
+            begin = count * index / size();
+            end = count * (index + 1) / size();
+        }
+
+        if (begin < end)
+            task(begin, end);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+        }
+        workDone.notify_all();
+    }
+}
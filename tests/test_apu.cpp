@@ -0,0 +1,287 @@
+#include "apu.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "doctest.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    const int32_t FRAME_CYCLES = 29781;
+
+    // Run whole frames and collect the samples
+    std::vector<int16_t> runFrames(APU &apu, int frames)
+    {
+        std::vector<int16_t> samples;
+        for (int i = 0; i < frames; ++i)
+        {
+            apu.endFrame(FRAME_CYCLES);
+            size_t start = samples.size();
+            samples.resize(start + apu.samplesAvailable());
+            apu.readSamples(samples.data() + start, apu.samplesAvailable());
+        }
+        return samples;
+    }
+
+    int countRisingEdges(const std::vector<int16_t> &samples)
+    {
+        int edges = 0;
+        for (size_t i = 1; i < samples.size(); ++i)
+        {
+            if (samples[i - 1] < 0 && samples[i] >= 0)
+                ++edges;
+        }
+        return edges;
+    }
+}
+
+TEST_CASE("APU - Silence After Reset")
+{
+    APU apu;
+    std::vector<int16_t> samples = runFrames(apu, 2);
+    CHECK(samples.size() >= 1467);
+    CHECK(std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }));
+}
+
+TEST_CASE("APU - Pulse Tone")
+{
+    APU apu;
+    apu.writeRegister(0x4015, 0x01);
+    apu.writeRegister(0x4000, 0xBF); // 50% duty, length halted, constant volume 15
+    apu.writeRegister(0x4002, 0xFD); // Period 253: 1789773 / (16 * 254) = 440.4 Hz
+    apu.writeRegister(0x4003, 0x00);
+
+    // One second of samples: one rising edge per period of the tone
+    std::vector<int16_t> samples = runFrames(apu, 60);
+    int edges = countRisingEdges(samples);
+    CHECK(edges >= 435);
+    CHECK(edges <= 445);
+    CHECK(*std::max_element(samples.begin(), samples.end()) > 1000);
+}
+
+TEST_CASE("APU - Channel Taps and Mutes")
+{
+    APU apu;
+    apu.setChannelTap(APU::Channel::Pulse1, true);
+    apu.setChannelTap(APU::Channel::Triangle, true);
+    CHECK(apu.channelSamplesAvailable(APU::Channel::Noise) == 0); // No tap
+
+    apu.writeRegister(0x4015, 0x01);
+    apu.writeRegister(0x4000, 0xBF); // Pulse 1 alone, as in the tone test
+    apu.writeRegister(0x4002, 0xFD);
+    apu.writeRegister(0x4003, 0x00);
+
+    auto readTap = [&apu](APU::Channel channel)
+    {
+        std::vector<int16_t> samples(apu.channelSamplesAvailable(channel));
+        apu.readChannelSamples(channel, samples.data(), static_cast<int>(samples.size()));
+        return samples;
+    };
+
+    // With a single channel playing, its tap is the mix. Taps hold 100ms like the mix buffer.
+    std::vector<int16_t> mix = runFrames(apu, 5);
+    std::vector<int16_t> pulse = readTap(APU::Channel::Pulse1);
+    std::vector<int16_t> triangle = readTap(APU::Channel::Triangle);
+    CHECK(pulse == mix);
+    REQUIRE(triangle.size() == mix.size());
+    CHECK(std::all_of(triangle.begin(), triangle.end(), [](int16_t s) { return s == 0; }));
+
+    // Muted, the channel leaves the mix but still plays in its tap
+    apu.setChannelMuted(APU::Channel::Pulse1, true);
+    CHECK(apu.isChannelMuted(APU::Channel::Pulse1));
+    runFrames(apu, 1); // Let the step out of the mix settle
+    readTap(APU::Channel::Pulse1);
+    mix = runFrames(apu, 5);
+    pulse = readTap(APU::Channel::Pulse1);
+    CHECK(*std::max_element(mix.begin(), mix.end()) < 50);
+    CHECK(countRisingEdges(pulse) >= 30);
+
+    apu.setChannelTap(APU::Channel::Pulse1, false);
+    runFrames(apu, 1);
+    CHECK(apu.channelSamplesAvailable(APU::Channel::Pulse1) == 0);
+}
+
+TEST_CASE("APU - Length Counter and Status")
+{
+    APU apu;
+    apu.writeRegister(0x4015, 0x0F);
+    apu.writeRegister(0x4000, 0x9F); // Length counter running
+    apu.writeRegister(0x4003, 0x00); // Length 10: five 4-step sequences
+    apu.writeRegister(0x400C, 0x3F); // Noise: length halted
+    apu.writeRegister(0x400F, 0x00);
+    CHECK((apu.readStatus() & 0x09) == 0x09);
+
+    runFrames(apu, 6);
+    CHECK((apu.readStatus() & 0x09) == 0x08);
+
+    apu.writeRegister(0x4015, 0x00); // Disabling clears the length counters
+    CHECK((apu.readStatus() & 0x0F) == 0);
+}
+
+TEST_CASE("APU - Frame Counter IRQ")
+{
+    APU apu;
+    runFrames(apu, 2); // Raised at the end of the 29830-cycle sequence
+    CHECK(apu.frameIrqPending());
+    CHECK((apu.readStatus() & 0x40) != 0);
+    CHECK_FALSE(apu.frameIrqPending()); // Acknowledged by the read
+
+    apu.writeRegister(0x4017, 0x40); // Inhibit
+    runFrames(apu, 2);
+    CHECK_FALSE(apu.frameIrqPending());
+
+    apu.writeRegister(0x4017, 0x80); // 5-step mode never raises it
+    runFrames(apu, 2);
+    CHECK_FALSE(apu.frameIrqPending());
+}
+
+TEST_CASE("APU - Frame IRQ Reaches the CPU")
+{
+    CPU cpu;
+    APU apu;
+    cpu.setAPU(&apu);
+    apu.setCPU(&cpu);
+
+    // NOPs from $8000, the handler at $D000
+    std::fill(cpu.memory.begin() + 0x8000, cpu.memory.begin() + 0xD100, 0xEA);
+    cpu.memory[0xFFFC] = 0x00;
+    cpu.memory[0xFFFD] = 0x80;
+    cpu.memory[0xFFFE] = 0x00;
+    cpu.memory[0xFFFF] = 0xD0;
+    cpu.reset();
+    apu.reset();
+    cpu.setFlag(CPU::I, false);
+
+    // Nothing accesses the APU: the interrupt is an event of its own
+    CHECK(cpu.nextEventCycle == INT_MAX);
+    cpu.runUntil(30000);
+    CHECK(cpu.irqLine == CPU::IRQ_APU_FRAME);
+    CHECK(cpu.PC >= 0xD000);
+
+    // Taken on the instruction after cycle 29829, from a NOP at $8000 + cycle / 2
+    uint16_t returnAddress = cpu.memory[0x0100 + cpu.SP + 2] | (cpu.memory[0x0100 + cpu.SP + 3] << 8);
+    CHECK(returnAddress == 0x8000 + 29830 / 2);
+
+    cpu.readMemory(0x4015); // Acknowledge
+    CHECK(cpu.irqLine == 0);
+}
+
+TEST_CASE("APU - DMC")
+{
+    CPU cpu;
+    APU apu;
+    apu.setCPU(&cpu);
+    cpu.setAPU(&apu);
+    cpu.cycles = 0;
+
+    SUBCASE("Direct load moves the output level")
+    {
+        cpu.writeMemory(0x4011, 0x7F);
+        cpu.cycles = 5000;
+        cpu.writeMemory(0x4011, 0x00);
+        std::vector<int16_t> samples = runFrames(apu, 1);
+        CHECK(*std::max_element(samples.begin(), samples.end()) > 5000);
+    }
+
+    SUBCASE("Samples are read from CPU memory and raise the IRQ at the end")
+    {
+        for (int i = 0; i < 17; ++i)
+        {
+            cpu.memory[0xC000 + i] = 0xFF; // Ramp the level up
+        }
+        cpu.writeMemory(0x4010, 0x8F); // IRQ, fastest rate
+        cpu.writeMemory(0x4012, 0x00); // $C000
+        cpu.writeMemory(0x4013, 0x01); // 17 bytes
+        cpu.writeMemory(0x4015, 0x10);
+        CHECK((cpu.readMemory(0x4015) & 0x10) != 0);
+
+        cpu.cycles = 17 * 8 * 54 + 100;
+        CHECK((cpu.readMemory(0x4015) & 0x90) == 0x80);
+        CHECK(apu.dmcIrqPending());
+        std::vector<int16_t> samples = runFrames(apu, 1);
+        CHECK(*std::max_element(samples.begin(), samples.end()) > 5000);
+    }
+}
+
+TEST_CASE("APU - DMC DMA")
+{
+    CPU cpu;
+    PPU ppu;
+    APU apu;
+    cpu.setPPU(&ppu);
+    ppu.setCPU(&cpu);
+    cpu.setAPU(&apu);
+    apu.setCPU(&cpu);
+
+    // NOPs from $8000, samples at $C000
+    std::fill(cpu.memory.begin() + 0x8000, cpu.memory.begin() + 0xC000, 0xEA);
+    cpu.memory[0xFFFC] = 0x00;
+    cpu.memory[0xFFFD] = 0x80;
+    cpu.reset();
+
+    auto startLoopingSample = [&]()
+    {
+        cpu.writeMemory(0x4010, 0x4F); // Loop, fastest rate: a fetch every 8 * 54 cycles
+        cpu.writeMemory(0x4012, 0x00);
+        cpu.writeMemory(0x4013, 0x00);
+        cpu.writeMemory(0x4015, 0x10);
+    };
+
+    SUBCASE("Each fetch is scheduled and stalls the CPU by 4 cycles")
+    {
+        startLoopingSample();
+        CHECK(apu.nextDmaCycle() == 0); // The buffer is empty: fetch right away
+        CHECK(cpu.nextEventCycle == 0);
+        cpu.cycles = 2; // Next instruction done
+        cpu.serviceEvents();
+        CHECK(cpu.cycles == 6);
+        CHECK(apu.nextDmaCycle() > 6);
+        CHECK(apu.nextDmaCycle() <= 9 * 54);
+        CHECK(cpu.nextEventCycle == apu.nextDmaCycle());
+    }
+
+    SUBCASE("Stalls take cycles from the running program")
+    {
+        startLoopingSample();
+        cpu.runUntil(10000);
+        int executed = cpu.PC - 0x8000; // One byte and 2 cycles per NOP
+        int stalled = 10000 - executed * 2;
+        CHECK(stalled >= 22 * 4);
+        CHECK(stalled <= 25 * 4);
+    }
+
+    SUBCASE("OAM DMA halts for 513 cycles, 514 from an odd cycle")
+    {
+        cpu.cycles = 100;
+        cpu.writeMemory(0x4014, 0x02);
+        CHECK(cpu.cycles == 613);
+
+        cpu.cycles = 101;
+        cpu.writeMemory(0x4014, 0x02);
+        CHECK(cpu.cycles == 615);
+
+        cpu.oddFrameStart = true; // The frame started on an odd cycle: parity flips
+        cpu.cycles = 100;
+        cpu.writeMemory(0x4014, 0x02);
+        CHECK(cpu.cycles == 614);
+    }
+
+    SUBCASE("A DMC fetch during OAM DMA steals 2 cycles and delays its end")
+    {
+        cpu.cycles = 100;
+        cpu.writeMemory(0x4014, 0x02);
+        cpu.stallForDmc(300);
+        CHECK(cpu.cycles == 615);
+        CHECK(cpu.oamDmaEnd == 615);
+        cpu.stallForDmc(700);
+        CHECK(cpu.cycles == 619);
+    }
+
+    SUBCASE("Frame rebasing keeps events and parity")
+    {
+        cpu.cycles = 29790;
+        cpu.endFrame(29781);
+        CHECK(cpu.cycles == 9);
+        CHECK(cpu.oddFrameStart);
+    }
+}
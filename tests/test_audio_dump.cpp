@@ -0,0 +1,126 @@
+#include "audio_dump.h"
+#include "doctest.h"
+#include "test_helpers.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    uint32_t readLittleEndian32(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+}
+
+TEST_CASE("AudioDump - Formats")
+{
+    // More samples than one block, so the file is written in several pieces
+    std::vector<int16_t> samples(50000);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<int16_t>(i * 7 - 20000);
+    }
+
+    SUBCASE("Format from the file name")
+    {
+        CHECK(AudioDump::formatForPath("out.wav") == AudioFormat::WAV);
+        CHECK(AudioDump::formatForPath("out.raw") == AudioFormat::RawPCM);
+        CHECK(AudioDump::formatForPath("out.pcm") == AudioFormat::RawPCM);
+        CHECK(AudioDump::formatForPath("-") == AudioFormat::WAV);
+    }
+
+    SUBCASE("WAV file with sizes filled in")
+    {
+        const std::string path = "test_dump.wav";
+        AudioDump dump;
+        REQUIRE(dump.open(path, AudioFormat::WAV, 44100));
+        dump.writeSamples(samples.data(), 1000);
+        dump.writeSamples(samples.data() + 1000, samples.size() - 1000);
+        dump.close();
+        CHECK_FALSE(dump.failed());
+        CHECK(dump.samplesWritten() == samples.size());
+
+        std::vector<uint8_t> data = readFile(path);
+        REQUIRE(data.size() == 44 + samples.size() * 2);
+        CHECK(memcmp(data.data(), "RIFF", 4) == 0);
+        CHECK(readLittleEndian32(&data[4]) == data.size() - 8);
+        CHECK(memcmp(data.data() + 8, "WAVEfmt ", 8) == 0);
+        CHECK(readLittleEndian32(&data[24]) == 44100);
+        CHECK(memcmp(data.data() + 36, "data", 4) == 0);
+        CHECK(readLittleEndian32(&data[40]) == samples.size() * 2);
+
+        for (size_t i = 0; i < samples.size(); i += 997)
+        {
+            int16_t value = static_cast<int16_t>(data[44 + i * 2] | (data[45 + i * 2] << 8));
+            CHECK(value == samples[i]);
+        }
+        remove(path.c_str());
+    }
+
+    SUBCASE("Raw samples")
+    {
+        const std::string path = "test_dump.raw";
+        AudioDump dump;
+        REQUIRE(dump.open(path, AudioFormat::RawPCM, 44100));
+        dump.writeSamples(samples.data(), 3);
+        dump.close();
+
+        std::vector<uint8_t> data = readFile(path);
+        REQUIRE(data.size() == 6);
+        CHECK(data[0] == 0xE0); // -20000 = 0xB1E0, little-endian
+        CHECK(data[1] == 0xB1);
+        remove(path.c_str());
+    }
+
+    SUBCASE("Write errors are reported")
+    {
+        // /dev/full accepts the open and fails every write, like a full disk
+        FILE *full = fopen("/dev/full", "wb");
+        if (!full)
+            return;
+        fclose(full);
+
+        AudioDump dump;
+        REQUIRE(dump.open("/dev/full", AudioFormat::RawPCM, 44100));
+        dump.writeSamples(samples.data(), samples.size());
+        dump.close();
+        CHECK(dump.failed());
+    }
+}
+
+TEST_CASE("AudioHash - Groups of Frames")
+{
+    std::vector<int16_t> frame(735);
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+        frame[i] = static_cast<int16_t>(i * 31);
+    }
+
+    AudioHash whole(2);
+    AudioHash split(2);
+    for (int n = 0; n < 4; ++n)
+    {
+        whole.addSamples(frame.data(), frame.size());
+        split.addSamples(frame.data(), 100);
+        split.addSamples(frame.data() + 100, frame.size() - 100);
+        CHECK(whole.endFrame() == (n % 2 == 1));
+        split.endFrame();
+    }
+
+    // Identical groups hash the same whichever way the samples were read
+    CHECK(whole.groups() == 2);
+    uint64_t reference = whole.value();
+    CHECK(reference != 0);
+    CHECK(split.value() == reference);
+
+    // One changed sample changes the hash
+    frame[500] ^= 1;
+    whole.addSamples(frame.data(), frame.size());
+    whole.endFrame();
+    frame[500] ^= 1;
+    whole.addSamples(frame.data(), frame.size());
+    whole.endFrame();
+    CHECK(whole.value() != reference);
+}
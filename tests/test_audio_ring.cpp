@@ -0,0 +1,97 @@
+#include "audio_ring.h"
+#include "doctest.h"
+#include <thread>
+#include <vector>
+
+TEST_CASE("AudioRing - Push and Pop")
+{
+    AudioRing ring(100);
+    CHECK(ring.capacity() == 128);
+
+    std::vector<int16_t> in(100);
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        in[i] = static_cast<int16_t>(i * 10);
+    }
+
+    SUBCASE("Samples come out in order across the wrap")
+    {
+        std::vector<int16_t> out(100);
+        for (int round = 0; round < 3; ++round)
+        {
+            CHECK(ring.push(in.data(), 100) == 100);
+            CHECK(ring.fillLevel() == 100);
+            CHECK(ring.pop(out.data(), 100) == 100);
+            CHECK(out == in);
+        }
+        CHECK(ring.fillLevel() == 0);
+        CHECK(ring.underruns() == 0);
+    }
+
+    SUBCASE("A full ring drops the newest samples")
+    {
+        CHECK(ring.push(in.data(), 100) == 100);
+        CHECK(ring.push(in.data(), 100) == 28);
+        CHECK(ring.dropped() == 72);
+        CHECK(ring.fillLevel() == 128);
+    }
+
+    SUBCASE("Underruns fade the last sample out")
+    {
+        std::vector<int16_t> loud(4, 16000);
+        ring.push(loud.data(), loud.size());
+        std::vector<int16_t> out(400);
+        CHECK(ring.pop(out.data(), out.size()) == 4);
+        CHECK(ring.underruns() == 1);
+        CHECK(ring.missingSamples() == 396);
+        CHECK(out[3] == 16000);
+        CHECK(out[4] < 16000);
+        CHECK(out[4] > 14000);
+        CHECK(out[399] == 0);
+    }
+}
+
+TEST_CASE("AudioRing - Threads")
+{
+    AudioRing ring(256);
+    const int total = 100000;
+
+    std::thread producer([&]()
+    {
+        int16_t next = 0;
+        int sent = 0;
+        while (sent < total)
+        {
+            int16_t block[37];
+            int n = std::min(37, total - sent);
+            for (int i = 0; i < n; ++i)
+            {
+                block[i] = static_cast<int16_t>(next + i);
+            }
+            size_t pushed = ring.push(block, n);
+            next = static_cast<int16_t>(next + pushed);
+            sent += static_cast<int>(pushed);
+        }
+    });
+
+    // Pop only what is there, so every sample must arrive exactly once and in order
+    int received = 0;
+    bool ordered = true;
+    int16_t block[64];
+    while (received < total)
+    {
+        size_t n = std::min<size_t>(ring.fillLevel(), 64);
+        if (n == 0)
+            continue;
+        ring.pop(block, n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ordered = ordered && block[i] == static_cast<int16_t>(received + i);
+        }
+        received += static_cast<int>(n);
+    }
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(ring.underruns() == 0);
+}
@@ -0,0 +1,63 @@
+#include "blip_buffer.h"
+#include "doctest.h"
+#include <cstdlib>
+#include <vector>
+
+TEST_CASE("BlipBuffer - Sample Counts")
+{
+    BlipBuffer blip(1789773.0, 44100, 4096);
+
+    // 10 frames of 29781 cycles are 7338.1 samples; the fraction carries into the next frame
+    int total = 0;
+    std::vector<int16_t> samples(1024);
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        blip.endFrame(29781);
+        total += blip.readSamples(samples.data(), static_cast<int>(samples.size()));
+    }
+    CHECK(total == 7338);
+    CHECK(blip.samplesAvailable() == 0);
+}
+
+TEST_CASE("BlipBuffer - Steps")
+{
+    BlipBuffer blip(1789773.0, 44100, 4096);
+    std::vector<int16_t> samples(256);
+
+    SUBCASE("A step settles at its amplitude, then decays through the high-pass")
+    {
+        blip.addDelta(1000, 10000);
+        blip.endFrame(29781);
+        int count = blip.readSamples(samples.data(), static_cast<int>(samples.size()));
+        REQUIRE(count == 256);
+
+        int index = 1000 * 44100 / 1789773; // The step's sample
+        CHECK(samples[index - 8] == 0);      // Nothing before the kernel starts
+        CHECK(std::abs(samples[index + 16] - 10000) < 400);
+        CHECK(samples[index + 200] < samples[index + 16]);
+        CHECK(samples[index + 200] > 5000);
+    }
+
+    SUBCASE("Every sub-sample phase reaches the same level")
+    {
+        // Steps spread over one output sample (40.6 clocks) differ only by the high-pass decay
+        for (int32_t time = 1000; time < 1041; time += 5)
+        {
+            blip.clear();
+            blip.addDelta(time, 10000);
+            blip.endFrame(29781);
+            blip.readSamples(samples.data(), static_cast<int>(samples.size()));
+            CHECK(std::abs(samples[60] - samples[59]) < 40);
+            CHECK(std::abs(samples[60] - 9400) < 100);
+        }
+    }
+
+    SUBCASE("Unread samples are dropped once the buffer is full")
+    {
+        for (int frame = 0; frame < 20; ++frame)
+        {
+            blip.endFrame(29781);
+        }
+        CHECK(blip.samplesAvailable() == 4096);
+    }
+}
@@ -0,0 +1,367 @@
+#include "cartridge.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "doctest.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // An iNES image whose 8KB PRG and 1KB CHR banks start with their own bank number. The rest
+    // of PRG is $FF, so writes to the discrete boards see no bus conflict.
+    std::vector<uint8_t> makeImage(int mapper, int prg16k, int chr8k, uint8_t flags6 = 0)
+    {
+        std::vector<uint8_t> image(16 + prg16k * 0x4000 + chr8k * 0x2000, 0xFF);
+        std::fill(image.begin(), image.begin() + 16, 0);
+        image[0] = 'N';
+        image[1] = 'E';
+        image[2] = 'S';
+        image[3] = 0x1A;
+        image[4] = static_cast<uint8_t>(prg16k);
+        image[5] = static_cast<uint8_t>(chr8k);
+        image[6] = static_cast<uint8_t>(flags6 | ((mapper & 0x0F) << 4));
+        image[7] = static_cast<uint8_t>(mapper & 0xF0);
+
+        for (int bank = 0; bank < prg16k * 2; ++bank)
+        {
+            image[16 + bank * 0x2000] = static_cast<uint8_t>(bank);
+        }
+        size_t chr = 16 + prg16k * 0x4000;
+        for (int bank = 0; bank < chr8k * 8; ++bank)
+        {
+            image[chr + bank * 0x400] = static_cast<uint8_t>(bank);
+        }
+        return image;
+    }
+
+    struct Board
+    {
+        Cartridge cartridge;
+        CPU cpu;
+        PPU ppu;
+
+        explicit Board(const std::vector<uint8_t> &image)
+        {
+            REQUIRE(cartridge.load(image.data(), image.size()));
+            cpu.setPPU(&ppu);
+            ppu.setCPU(&cpu);
+            cartridge.connect(&cpu, &ppu);
+        }
+
+        uint8_t chrBank(uint16_t address) const { return ppu.patternData(address)[0]; }
+    };
+
+    // MMC1 registers are written one bit at a time, least significant first
+    void writeSerial(CPU &cpu, uint16_t address, uint8_t value)
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            cpu.writeMemory(address, (value >> i) & 0x01);
+        }
+    }
+}
+
+TEST_CASE("Cartridge - iNES Header")
+{
+    Cartridge cartridge;
+
+    SUBCASE("Sizes, mapper number and CHR-RAM")
+    {
+        std::vector<uint8_t> image = makeImage(4, 8, 0);
+        REQUIRE(cartridge.load(image.data(), image.size()));
+        CHECK(cartridge.getMapperNumber() == 4);
+        CHECK(cartridge.getPrgSize() == 0x20000);
+        CHECK(cartridge.getChrSize() == 0);
+        CHECK(cartridge.hasChrRam());
+    }
+
+    SUBCASE("Rejected images")
+    {
+        std::vector<uint8_t> good = makeImage(3, 2, 4);
+        REQUIRE(cartridge.load(good.data(), good.size()));
+        CPU cpu;
+        PPU ppu;
+        cpu.setPPU(&ppu);
+        ppu.setCPU(&cpu);
+        cartridge.connect(&cpu, &ppu);
+
+        std::vector<uint8_t> image = makeImage(5, 1, 1); // MMC5
+        CHECK_FALSE(cartridge.load(image.data(), image.size()));
+
+        image = makeImage(0, 1, 1);
+        CHECK_FALSE(cartridge.load(image.data(), image.size() - 1)); // Truncated CHR
+
+        image[0] = 'X';
+        CHECK_FALSE(cartridge.load(image.data(), image.size()));
+
+        // The loaded cartridge is untouched, and its banks still wrap by its own sizes
+        CHECK(cartridge.getMapperNumber() == 3);
+        CHECK(cartridge.getPrgSize() == 0x8000);
+        CHECK(cartridge.getChrSize() == 0x8000);
+        CHECK(cpu.readMemory(0xA000) == 1);
+        cpu.writeMemory(0x8001, 3);
+        CHECK(ppu.patternData(0x0000)[0] == 24);
+        CHECK(ppu.patternData(0x1C00)[0] == 31);
+    }
+}
+
+TEST_CASE("Cartridge - Mapped ROM File")
+{
+    const char *path = "test_mapped.nes";
+    std::vector<uint8_t> image = makeImage(3, 2, 4);
+    FILE *rom = fopen(path, "wb");
+    REQUIRE(rom);
+    fwrite(image.data(), 1, image.size(), rom);
+    fclose(rom);
+
+    Cartridge cartridge;
+    CHECK_FALSE(cartridge.load(std::string("missing.nes")));
+    REQUIRE(cartridge.load(std::string(path)));
+    remove(path); // The mapping outlives the directory entry
+
+    CPU cpu;
+    PPU ppu;
+    cpu.setPPU(&ppu);
+    ppu.setCPU(&cpu);
+    cartridge.connect(&cpu, &ppu);
+    CHECK(cpu.readMemory(0xA000) == 1);
+    CHECK(ppu.patternData(0x0C00)[0] == 3);
+
+    // PPUDATA writes to CHR-ROM are dropped rather than written into the read-only mapping
+    ppu.writeRegister(0x2006, 0x0C);
+    ppu.writeRegister(0x2006, 0x00);
+    ppu.writeRegister(0x2007, 0xA5);
+    CHECK(ppu.patternData(0x0C00)[0] == 3);
+
+    cpu.writeMemory(0x8001, 1);
+    CHECK(ppu.patternData(0x0C00)[0] == 11);
+}
+
+TEST_CASE("Cartridge - Discrete Boards")
+{
+    SUBCASE("NROM-128 mirrors its 16KB")
+    {
+        std::vector<uint8_t> image = makeImage(0, 1, 1, 0x01);
+        image[16 + 0x3FFC] = 0x34; // Reset vector at the end of the bank
+        image[16 + 0x3FFD] = 0x92;
+        Board board(image);
+        CHECK(board.cpu.readMemory(0x8000) == 0);
+        CHECK(board.cpu.readMemory(0xC000) == 0);
+        CHECK(board.cpu.readMemory(0xFFFC) == 0x34);
+        CHECK(board.cpu.readMemory(0xFFFD) == 0x92);
+        CHECK(board.ppu.getMirroring() == Mirroring::Vertical);
+
+        // PRG-RAM at $6000
+        board.cpu.writeMemory(0x6123, 0x5A);
+        CHECK(board.cpu.readMemory(0x6123) == 0x5A);
+    }
+
+    SUBCASE("UxROM switches $8000 and fixes the last bank")
+    {
+        Board board(makeImage(2, 8, 0));
+        CHECK(board.cpu.readMemory(0xC000) == 14);
+        board.cpu.writeMemory(0x8001, 3);
+        CHECK(board.cpu.readMemory(0x8000) == 6);
+        CHECK(board.cpu.readMemory(0xA000) == 7);
+        CHECK(board.cpu.readMemory(0xC000) == 14);
+
+        // Bus conflict: the ROM byte at $8000 is now 6, and 5 & 6 selects bank 4
+        board.cpu.writeMemory(0x8000, 5);
+        CHECK(board.cpu.readMemory(0x8000) == 8);
+
+        // CHR-RAM is writable through PPUDATA
+        board.ppu.writeRegister(0x2006, 0x04);
+        board.ppu.writeRegister(0x2006, 0x00);
+        board.ppu.writeRegister(0x2007, 0xA5);
+        CHECK(board.chrBank(0x0400) == 0xA5);
+    }
+
+    SUBCASE("CNROM switches 8KB of CHR")
+    {
+        Board board(makeImage(3, 2, 4));
+        CHECK(board.chrBank(0x1C00) == 7);
+        board.cpu.writeMemory(0x8001, 2);
+        CHECK(board.chrBank(0x0000) == 16);
+        CHECK(board.chrBank(0x1C00) == 23);
+        CHECK(board.cpu.readMemory(0x8000) == 0);
+
+        // CHR-ROM ignores PPUDATA writes
+        board.ppu.writeRegister(0x2006, 0x00);
+        board.ppu.writeRegister(0x2006, 0x00);
+        board.ppu.writeRegister(0x2007, 0xA5);
+        CHECK(board.chrBank(0x0000) == 16);
+    }
+
+    SUBCASE("AxROM switches 32KB and the single screen")
+    {
+        Board board(makeImage(7, 8, 0));
+        CHECK(board.ppu.getMirroring() == Mirroring::SingleScreenA);
+        board.cpu.writeMemory(0x8001, 0x12);
+        CHECK(board.cpu.readMemory(0x8000) == 8);
+        CHECK(board.cpu.readMemory(0xE000) == 11);
+        CHECK(board.ppu.getMirroring() == Mirroring::SingleScreenB);
+    }
+}
+
+TEST_CASE("Cartridge - MMC1")
+{
+    Board board(makeImage(1, 8, 4));
+
+    // Power-on: last bank fixed at $C000
+    CHECK(board.cpu.readMemory(0xC000) == 14);
+
+    writeSerial(board.cpu, 0xE000, 2);
+    CHECK(board.cpu.readMemory(0x8000) == 4);
+    CHECK(board.cpu.readMemory(0xC000) == 14);
+
+    // Four bits then a reset leave the bank alone
+    for (int i = 0; i < 4; ++i)
+    {
+        board.cpu.writeMemory(0xE000, 1);
+    }
+    board.cpu.writeMemory(0xE000, 0x80);
+    CHECK(board.cpu.readMemory(0x8000) == 4);
+
+    // Control: vertical mirroring, PRG mode 2 (first bank fixed), 4KB CHR banks
+    writeSerial(board.cpu, 0x8000, 0x1A);
+    CHECK(board.ppu.getMirroring() == Mirroring::Vertical);
+    CHECK(board.cpu.readMemory(0x8000) == 0);
+    CHECK(board.cpu.readMemory(0xC000) == 4);
+
+    writeSerial(board.cpu, 0xA000, 3);
+    writeSerial(board.cpu, 0xC000, 6);
+    CHECK(board.chrBank(0x0000) == 12);
+    CHECK(board.chrBank(0x1000) == 24);
+}
+
+TEST_CASE("Cartridge - MMC3")
+{
+    Board board(makeImage(4, 8, 8));
+
+    SUBCASE("PRG banks")
+    {
+        board.cpu.writeMemory(0x8000, 6);
+        board.cpu.writeMemory(0x8001, 5);
+        board.cpu.writeMemory(0x8000, 7);
+        board.cpu.writeMemory(0x8001, 9);
+        CHECK(board.cpu.readMemory(0x8000) == 5);
+        CHECK(board.cpu.readMemory(0xA000) == 9);
+        CHECK(board.cpu.readMemory(0xC000) == 14);
+        CHECK(board.cpu.readMemory(0xE000) == 15);
+
+        // Bit 6 swaps $8000 and $C000
+        board.cpu.writeMemory(0x8000, 0x46);
+        CHECK(board.cpu.readMemory(0x8000) == 14);
+        CHECK(board.cpu.readMemory(0xC000) == 5);
+    }
+
+    SUBCASE("CHR banks")
+    {
+        board.cpu.writeMemory(0x8000, 0);
+        board.cpu.writeMemory(0x8001, 6);
+        board.cpu.writeMemory(0x8000, 2);
+        board.cpu.writeMemory(0x8001, 33);
+        CHECK(board.chrBank(0x0000) == 6);
+        CHECK(board.chrBank(0x0400) == 7);
+        CHECK(board.chrBank(0x1000) == 33);
+
+        // Bit 7 swaps the pattern table halves
+        board.cpu.writeMemory(0x8000, 0x80);
+        CHECK(board.chrBank(0x1000) == 6);
+        CHECK(board.chrBank(0x1400) == 7);
+        CHECK(board.chrBank(0x0000) == 33);
+    }
+
+    SUBCASE("Mirroring")
+    {
+        board.cpu.writeMemory(0xA000, 1);
+        CHECK(board.ppu.getMirroring() == Mirroring::Horizontal);
+        board.cpu.writeMemory(0xA000, 0);
+        CHECK(board.ppu.getMirroring() == Mirroring::Vertical);
+    }
+
+    SUBCASE("CHR switches mid-frame show from the next scanline")
+    {
+        // Tile 0, row 0 is plane 0 = bank number, plane 1 = $FF: colour 2, or 3 where the bank has bits set
+        board.ppu.memory[0x3F02] = 0x12;
+        board.ppu.memory[0x3F03] = 0x13;
+        board.ppu.writeRegister(0x2001, 0x0A);
+        board.ppu.setRenderThreads(2);
+
+        board.cpu.cycles = PPU::scanlineStartCycle(100) - 10;
+        board.cpu.writeMemory(0x8000, 0);
+        board.cpu.writeMemory(0x8001, 6); // $0000-$07FF: banks 6 and 7
+        board.cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        board.ppu.renderFrame();
+        Frame frame;
+        board.ppu.copyFrame(frame);
+
+        CHECK(board.ppu.getScanlineChrPages(99)[0][0] == 0);
+        CHECK(board.ppu.getScanlineChrPages(100)[0][0] == 6);
+        CHECK(frame.pixels[96 * 256 + 5] == 0x12);  // Bank 0
+        CHECK(frame.pixels[104 * 256 + 5] == 0x13); // Bank 6 = %00000110
+        CHECK(frame.pixels[104 * 256 + 4] == 0x12);
+    }
+
+    SUBCASE("Scanline IRQ")
+    {
+        board.cpu.writeMemory(0xC000, 9); // Latch
+        board.cpu.writeMemory(0xC001, 0); // Reload on the next clock
+        board.cpu.writeMemory(0xE001, 0); // Enable
+
+        // Counters stop while rendering is off
+        CHECK(board.cartridge.nextEventCycle() == INT_MAX);
+        board.ppu.writeRegister(0x2001, 0x18);
+
+        // Reload on the pre-render line, then nine decrements: dot 260 of scanline 8
+        int irqCycle = board.cartridge.nextEventCycle();
+        CHECK(irqCycle == PPU::scanlineStartCycle(8) + 86);
+        board.cartridge.catchUp(irqCycle - 1);
+        CHECK(board.cpu.irqLine == 0);
+        board.cartridge.catchUp(irqCycle);
+        CHECK(board.cpu.irqLine == CPU::IRQ_MAPPER);
+        CHECK(board.cartridge.nextEventCycle() == INT_MAX);
+
+        // $E000 acknowledges; the counter reloads and fires again ten lines later
+        board.cpu.writeMemory(0xE000, 0);
+        CHECK(board.cpu.irqLine == 0);
+        board.cpu.writeMemory(0xE001, 0);
+        CHECK(board.cartridge.nextEventCycle() == PPU::scanlineStartCycle(18) + 86);
+
+        // Every ten lines since, up to the last one; the count carries into the next frame
+        board.cartridge.catchUp(PPU::scanlineStartCycle(238) + 86);
+        CHECK(board.cpu.irqLine == CPU::IRQ_MAPPER);
+        board.cpu.writeMemory(0xE000, 0);
+        board.cpu.writeMemory(0xE001, 0);
+        board.cartridge.endFrame(PPU::CPU_CYCLES_PER_FRAME);
+        CHECK(board.cartridge.nextEventCycle() == PPU::scanlineStartCycle(7) + 86);
+    }
+}
+
+TEST_CASE("Cartridge - MMC3 IRQ at an Instruction Boundary")
+{
+    // NOPs in the fixed last bank, with the reset vector at $E000 and the IRQ handler at $F000
+    std::vector<uint8_t> image = makeImage(4, 8, 8);
+    size_t lastBank = 16 + 15 * 0x2000;
+    std::fill(image.begin() + lastBank, image.begin() + lastBank + 0x2000, 0xEA);
+    image[lastBank + 0x1FFC] = 0x00;
+    image[lastBank + 0x1FFD] = 0xE0;
+    image[lastBank + 0x1FFE] = 0x00;
+    image[lastBank + 0x1FFF] = 0xF0;
+    Board board(image);
+    board.cpu.reset();
+    board.cpu.setFlag(CPU::I, false);
+
+    board.cpu.writeMemory(0xC000, 9);
+    board.cpu.writeMemory(0xC001, 0);
+    board.cpu.writeMemory(0xE001, 0);
+    board.ppu.writeRegister(0x2001, 0x18);
+    int irqCycle = board.cartridge.nextEventCycle();
+
+    // The last NOP ends on the IRQ's cycle: the IRQ is taken there, not one instruction later
+    board.cpu.cycles = irqCycle - 20;
+    board.cpu.runUntil(irqCycle + 1);
+    CHECK(board.cpu.PC == 0xF000);
+    CHECK(board.cpu.cycles == irqCycle + 7);
+}
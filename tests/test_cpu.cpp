@@ -1,6 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "cpu.h"
+#include <algorithm>
 
 TEST_CASE("ADC - Add with Carry")
 {
@@ -2853,3 +2854,64 @@ TEST_CASE("Opcode Cycles - Base Cycle Count Test with Flags")
         CHECK(cpu.PC == 0x1235); // PC restored and incremented
     }
 }
+
+TEST_CASE("IRQ - Level-Sensitive Line")
+{
+    CPU cpu;
+    cpu.memory[0xFFFC] = 0x00;
+    cpu.memory[0xFFFD] = 0x80;
+    cpu.memory[0xFFFE] = 0x00; // Handler at $9000
+    cpu.memory[0xFFFF] = 0x90;
+    std::fill(cpu.memory.begin() + 0x8000, cpu.memory.begin() + 0x8100, 0xEA); // NOPs
+    cpu.reset();
+    CHECK(cpu.getFlag(CPU::I)); // Interrupts start disabled
+
+    SUBCASE("Masked by I, taken one instruction after CLI")
+    {
+        cpu.setIrq(CPU::IRQ_MAPPER, true);
+        cpu.runUntil(10);
+        CHECK(cpu.PC == 0x8005); // Masked: five NOPs
+
+        cpu.memory[0x8005] = 0x58; // CLI
+        cpu.runUntil(12);
+        CHECK(cpu.PC == 0x8006);   // The poll after CLI still sees I set
+        cpu.runUntil(14);
+        CHECK(cpu.PC == 0x9000);   // Taken after the next NOP
+        CHECK(cpu.cycles == 21);
+        CHECK(cpu.getFlag(CPU::I));
+
+        // Return address $8007 and the flags, with B clear and I clear
+        CHECK(cpu.memory[0x0100 + cpu.SP + 1] == 0x20);
+        CHECK(cpu.memory[0x0100 + cpu.SP + 2] == 0x07);
+        CHECK(cpu.memory[0x0100 + cpu.SP + 3] == 0x80);
+    }
+
+    SUBCASE("Held until every source releases it")
+    {
+        cpu.memory[0x9000] = 0x40; // RTI
+        cpu.setFlag(CPU::I, false);
+        cpu.setIrq(CPU::IRQ_APU_FRAME, true);
+        cpu.setIrq(CPU::IRQ_MAPPER, true);
+        cpu.runUntil(1);
+        CHECK(cpu.PC == 0x9000);
+
+        cpu.setIrq(CPU::IRQ_APU_FRAME, false);
+        cpu.runUntil(cpu.cycles + 1);
+        CHECK(cpu.PC == 0x9000); // RTI restored I clear and the mapper still asserts the line
+
+        cpu.setIrq(CPU::IRQ_MAPPER, false);
+        CHECK(cpu.irqLine == 0);
+        cpu.runUntil(cpu.cycles + 1);
+        CHECK(cpu.PC == 0x8001);
+    }
+
+    SUBCASE("A pending IRQ is still taken after SEI")
+    {
+        cpu.memory[0x8000] = 0x78; // SEI
+        cpu.setFlag(CPU::I, false);
+        cpu.setIrq(CPU::IRQ_APU_DMC, true);
+        cpu.runUntil(1);
+        CHECK(cpu.PC == 0x9000);
+        CHECK((cpu.memory[0x0100 + cpu.SP + 1] & 0x04) != 0); // Pushed with I set by SEI
+    }
+}
@@ -0,0 +1,57 @@
+#include "dirty_rows.h"
+#include "doctest.h"
+#include <utility>
+#include <vector>
+
+TEST_CASE("DirtyRowTracker - Changed Row Ranges")
+{
+    Frame frame;
+    for (int row = 0; row < 240; ++row)
+    {
+        frame.rowHashes[row] = 1000 + row;
+    }
+
+    DirtyRowTracker tracker;
+    std::vector<std::pair<int, int>> ranges;
+    auto collect = [&](int begin, int end) { ranges.push_back({begin, end}); };
+
+    SUBCASE("The first frame is uploaded in full")
+    {
+        CHECK(tracker.update(frame) == 240);
+        tracker.forEachDirtyRange(collect);
+        REQUIRE(ranges.size() == 1);
+        CHECK(ranges[0] == std::make_pair(0, 240));
+    }
+
+    SUBCASE("Unchanged frames upload nothing")
+    {
+        tracker.update(frame);
+        CHECK(tracker.update(frame) == 0);
+        tracker.forEachDirtyRange(collect);
+        CHECK(ranges.empty());
+    }
+
+    SUBCASE("Changed rows are grouped into contiguous ranges")
+    {
+        tracker.update(frame);
+        frame.rowHashes[10] = 1;
+        frame.rowHashes[11] = 2;
+        frame.rowHashes[12] = 3;
+        frame.rowHashes[239] = 4;
+        CHECK(tracker.update(frame) == 4);
+        CHECK(tracker.isDirty(11));
+        CHECK_FALSE(tracker.isDirty(13));
+
+        tracker.forEachDirtyRange(collect);
+        REQUIRE(ranges.size() == 2);
+        CHECK(ranges[0] == std::make_pair(10, 13));
+        CHECK(ranges[1] == std::make_pair(239, 240));
+    }
+
+    SUBCASE("Invalidating forces a full upload")
+    {
+        tracker.update(frame);
+        tracker.invalidate();
+        CHECK(tracker.update(frame) == 240);
+    }
+}
@@ -0,0 +1,29 @@
+#include "frame_hash.h"
+#include "doctest.h"
+#include <cstring>
+#include <vector>
+
+TEST_CASE("FrameHash - XXH64 Reference Values")
+{
+    CHECK(hash64("", 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(hash64("a", 1) == 0xD24EC4F1A98C6E5BULL);
+    CHECK(hash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+    const char *text = "Nobody inspects the spammish repetition";
+    CHECK(hash64(text, strlen(text)) == 0xFBCEA83C8A378BF1ULL);
+}
+
+TEST_CASE("FrameHash - Rows and Frames")
+{
+    std::vector<uint8_t> row(256, 0x0F);
+    uint64_t base = hash64(row.data(), row.size());
+
+    CHECK(hash64(row.data(), row.size(), 1) != base); // Seed (emphasis) changes the hash
+    row[200] = 0x10;
+    CHECK(hash64(row.data(), row.size()) != base);
+
+    std::vector<uint64_t> rows(240, base);
+    uint64_t frame = hashFrameRows(rows.data(), 240);
+    rows[239] ^= 1;
+    CHECK(hashFrameRows(rows.data(), 240) != frame);
+}
@@ -0,0 +1,55 @@
+#include "frame_pacer.h"
+#include "doctest.h"
+#include <atomic>
+#include <numeric>
+#include <thread>
+
+TEST_CASE("FramePacer - Sync Sources")
+{
+    using Clock = FramePacer::Clock;
+
+    SUBCASE("Wall clock runs at the frame rate")
+    {
+        FramePacer pacer(200.0); // 5ms frames
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < 11; ++i)
+        {
+            pacer.waitForNextFrame(); // The first call only starts the clock
+        }
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        CHECK(elapsedMs >= 49.0); // No upper bound: a loaded machine may oversleep any amount
+
+        const auto &histogram = pacer.jitterHistogram();
+        CHECK(std::accumulate(histogram.begin(), histogram.end(), 0u) == 10);
+        CHECK(pacer.formatJitterHistogram().find("ms") != std::string::npos);
+    }
+
+    SUBCASE("Vsync waits for the presenting thread")
+    {
+        FramePacer pacer;
+        pacer.setSyncSource(SyncSource::Vsync);
+        pacer.waitForNextFrame();
+
+        std::atomic<bool> released(false);
+        std::thread emulation([&]()
+                              {
+                                  pacer.waitForNextFrame();
+                                  released = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK_FALSE(released.load());
+        pacer.signalVsync();
+        emulation.join();
+        CHECK(released.load());
+    }
+
+    SUBCASE("Audio queue holds frames while the queue is full")
+    {
+        FramePacer pacer;
+        std::atomic<int> polls(0);
+        pacer.setAudioQueue([&]() { return ++polls < 5 ? 0.1 : 0.01; }, 0.05);
+        pacer.setSyncSource(SyncSource::AudioQueue);
+        pacer.waitForNextFrame();
+        pacer.waitForNextFrame();
+        CHECK(polls.load() == 5);
+    }
+}
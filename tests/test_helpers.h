@@ -0,0 +1,26 @@
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Whole contents of a file written by a test, empty if it cannot be opened
+inline std::vector<uint8_t> readFile(const std::string &path)
+{
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return data;
+    uint8_t chunk[4096];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    fclose(file);
+    return data;
+}
+
+#endif // TEST_HELPERS_H
@@ -0,0 +1,76 @@
+#include "ntsc.h"
+#include "palette.h"
+#include "worker_pool.h"
+#include "doctest.h"
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    // Filter a frame that is one colour everywhere and return the centre output pixel
+    uint32_t flatColor(uint8_t index, uint8_t emphasis)
+    {
+        std::vector<uint8_t> indices(256 * 4, index);
+        std::vector<uint8_t> lineEmphasis(4, emphasis);
+        std::vector<uint32_t> output(NTSC_OUTPUT_WIDTH * 4);
+        ntscFilterFrame(indices.data(), lineEmphasis.data(), 4, 0, output.data(), NTSC_OUTPUT_WIDTH * 4);
+        return output[NTSC_OUTPUT_WIDTH * 2 + 256];
+    }
+
+    bool closeTo(uint32_t a, uint32_t b, int tolerance)
+    {
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            if (std::abs(static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF)) > tolerance)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE("NTSC - Flat Colours")
+{
+    CHECK((flatColor(0x0F, 0) & 0xFFFFFF) == 0x000000);
+    CHECK((flatColor(0x30, 0) & 0xFFFFFF) == 0xFFFFFF);
+    CHECK((flatColor(0x00, 0) & 0xFFFFFF) == 0x666666); // Greys carry no colour
+
+    // Decoded colours land close to the RGB palette
+    const uint8_t colors[] = {0x11, 0x12, 0x16, 0x18, 0x1A, 0x21, 0x27, 0x2C};
+    for (uint8_t color : colors)
+    {
+        CHECK(closeTo(flatColor(color, 0), paletteARGB(0)[color], 12));
+    }
+
+    // Red emphasis darkens green and blue
+    uint32_t emphasised = flatColor(0x30, 0x01);
+    CHECK(((emphasised >> 16) & 0xFF) == 0xFF);
+    CHECK(((emphasised >> 8) & 0xFF) < 0xD0);
+    CHECK((emphasised & 0xFF) < 0xD0);
+}
+
+TEST_CASE("NTSC - Composite Artifacts")
+{
+    // Alternating black and white columns: the fine detail turns into colour fringes
+    std::vector<uint8_t> indices(256 * 3);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = (i & 1) ? 0x30 : 0x0F;
+    }
+    std::vector<uint8_t> lineEmphasis(3, 0);
+    std::vector<uint32_t> even(NTSC_OUTPUT_WIDTH * 3);
+    std::vector<uint32_t> odd(NTSC_OUTPUT_WIDTH * 3);
+    ntscFilterFrame(indices.data(), lineEmphasis.data(), 3, 0, even.data(), NTSC_OUTPUT_WIDTH * 4);
+    ntscFilterFrame(indices.data(), lineEmphasis.data(), 3, 1, odd.data(), NTSC_OUTPUT_WIDTH * 4);
+
+    uint32_t pixel = even[NTSC_OUTPUT_WIDTH + 256];
+    CHECK(((pixel >> 16) & 0xFF) != (pixel & 0xFF)); // Not grey
+    CHECK(even != odd);                                // Dot crawl between frame phases
+
+    SUBCASE("Rows on workers match serial filtering")
+    {
+        WorkerPool pool(2);
+        std::vector<uint32_t> banded(even.size());
+        ntscFilterFrame(indices.data(), lineEmphasis.data(), 3, 0, banded.data(), NTSC_OUTPUT_WIDTH * 4, &pool);
+        CHECK(banded == even);
+    }
+}
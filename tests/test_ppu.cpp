@@ -1,7 +1,10 @@
 #include "ppu.h"
+#include "palette.h"
+#include "cpu.h"
 #include "doctest.h"
 #include <iostream>
 #include <bitset>
+#include <vector>
 
 // Helper for VRAM address setup
 void setPPUAddress(PPU &ppu, uint16_t address)
@@ -13,10 +16,20 @@ void setPPUAddress(PPU &ppu, uint16_t address)
 bool hasNonZeroPixels(const PPU &ppu)
 {
     return std::any_of(ppu.framebuffer.begin(), ppu.framebuffer.end(),
-                       [](uint32_t pixel)
+                       [](uint8_t pixel)
                        { return pixel != 0; });
 }
 
+// Helper for palette RAM setup: distinct colours for every background and sprite entry
+void initializePalette(PPU &ppu)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        ppu.memory[0x3F00 + i] = 0x10 + i;
+    }
+    ppu.memory[0x3F00] = 0x0F; // Black backdrop
+}
+
 // Helper for Simplified Tile Data Initialization
 void initializeTileData(PPU &ppu, uint8_t tileIndex, uint8_t pattern)
 {
@@ -152,7 +165,7 @@ TEST_CASE("PPU - Reset Behavior")
                       { return x == 0; }));
     CHECK(std::all_of(ppu.oam.begin(), ppu.oam.end(), [](uint8_t x)
                       { return x == 0; }));
-    CHECK(std::all_of(ppu.framebuffer.begin(), ppu.framebuffer.end(), [](uint32_t x)
+    CHECK(std::all_of(ppu.framebuffer.begin(), ppu.framebuffer.end(), [](uint8_t x)
                       { return x == 0; }));
 
     std::cout << "PPU reset test passed!" << std::endl;
@@ -162,10 +175,12 @@ TEST_CASE("PPU - Background Rendering")
 {
     PPU ppu;
     ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
 
     // Initialize nametable and pattern table
     memset(ppu.memory.data() + 0x2000, 1, 1024);
     initializeTileData(ppu, 1, 0xFF); // Tile 1: All pixels set to 1 (visible)
+    initializePalette(ppu);
 
     // Render background
     ppu.renderBackground();
@@ -182,6 +197,7 @@ TEST_CASE("PPU - Sprite Rendering")
 {
     PPU ppu;
     ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
 
     // Initialize sprite data
     memset(ppu.oam.data(), 0, 256); // Clear OAM
@@ -191,6 +207,7 @@ TEST_CASE("PPU - Sprite Rendering")
     ppu.oam[3] = 50;                // X-coordinate
 
     initializeTileData(ppu, 1, 0xFF); // Tile 1: All pixels set to 1 (visible)
+    initializePalette(ppu);
 
     // Render sprites
     ppu.renderSprites();
@@ -200,4 +217,732 @@ TEST_CASE("PPU - Sprite Rendering")
     std::cerr << "[DEBUG] Sprite Rendering: Non-zero pixels found = " << foundNonZero << std::endl;
 
     CHECK(foundNonZero);
-}
\ No newline at end of file
+}
+// Sprite Evaluation Tests
+TEST_CASE("PPU - Sprite Evaluation")
+{
+    PPU ppu;
+    ppu.reset();
+
+    SUBCASE("At most 8 sprites per scanline and overflow flag")
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            ppu.oam[i * 4] = 49;         // Y-coordinate (drawn on lines 50-57)
+            ppu.oam[i * 4 + 1] = 1;      // Tile index 1
+            ppu.oam[i * 4 + 3] = i * 10; // X-coordinate
+        }
+        for (int i = 10; i < 64; ++i)
+        {
+            ppu.oam[i * 4] = 0xFF; // Off screen
+        }
+        ppu.invalidateSpriteCache();
+        ppu.evaluateSprites();
+
+        const PPU::SpriteLine &line = ppu.getSpriteLine(50);
+        CHECK(line.count == 8);
+        CHECK(line.overflow);
+        CHECK(line.hasSpriteZero);
+        CHECK(line.oam[7 * 4 + 3] == 70); // Eighth sprite kept, ninth and tenth dropped
+        CHECK(ppu.getSpriteLine(49).count == 0);
+        CHECK(ppu.getSpriteLine(58).count == 0);
+
+        ppu.writeRegister(0x2001, 0x18); // Evaluation only runs while rendering is enabled
+        ppu.renderFrame();
+        CHECK((ppu.PPUSTATUS & 0x20) != 0);
+    }
+
+    SUBCASE("Sprite 0 hit over opaque background")
+    {
+        memset(ppu.memory.data() + 0x2000, 1, 960); // Every background tile is tile 1
+        initializeTileData(ppu, 1, 0xFF);
+        memset(ppu.oam.data(), 0xFF, 256);
+        ppu.oam[0] = 100; // Sprite 0 Y
+        ppu.oam[1] = 1;   // Tile index 1
+        ppu.oam[2] = 0;
+        ppu.oam[3] = 50; // Sprite 0 X
+        ppu.invalidateSpriteCache();
+
+        ppu.renderFrame();
+        CHECK((ppu.PPUSTATUS & 0x40) == 0); // Rendering disabled in PPUMASK
+
+        ppu.writeRegister(0x2001, 0x1E); // Show background and sprites
+        ppu.renderFrame();
+        CHECK((ppu.PPUSTATUS & 0x40) != 0);
+        CHECK((ppu.PPUSTATUS & 0x20) == 0);
+    }
+
+    SUBCASE("No sprite 0 hit over transparent background")
+    {
+        ppu.oam[0] = 100;
+        ppu.oam[1] = 1;
+        ppu.oam[3] = 50;
+        initializeTileData(ppu, 1, 0xFF);
+        memset(ppu.memory.data() + 0x2000, 0, 960); // Tile 0 is blank
+        ppu.invalidateSpriteCache();
+        ppu.writeRegister(0x2001, 0x1E);
+
+        ppu.renderFrame();
+        CHECK((ppu.PPUSTATUS & 0x40) == 0);
+    }
+}
+
+// Palette and Colour Conversion Tests
+TEST_CASE("PPU - Indexed Framebuffer")
+{
+    PPU ppu;
+    ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF); // Tile 1: every pixel uses colour 3
+
+    SUBCASE("Palette RAM mirrors through PPUDATA")
+    {
+        setPPUAddress(ppu, 0x3F10);
+        ppu.writeRegister(0x2007, 0x21);
+        CHECK(ppu.memory[0x3F00] == 0x21); // $3F10 mirrors $3F00
+        CHECK(ppu.readPalette(0x10) == 0x21);
+
+        setPPUAddress(ppu, 0x3F25);
+        ppu.writeRegister(0x2007, 0x2A);
+        CHECK(ppu.readPalette(0x05) == 0x2A); // $3F20-$3FFF mirror $3F00-$3F1F
+    }
+
+    SUBCASE("Background and sprite pixels hold palette indices")
+    {
+        memset(ppu.memory.data() + 0x2000, 1, 32); // First tile row uses tile 1
+        ppu.oam[0] = 100;
+        ppu.oam[1] = 1;
+        ppu.oam[3] = 50;
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+
+        CHECK(ppu.framebuffer[0] == 0x13);                // Background palette 0, colour 3
+        CHECK(ppu.framebuffer[8 * 256] == 0x0F);          // Tile 0 is transparent: backdrop
+        CHECK(ppu.framebuffer[101 * 256 + 50] == 0x23);   // Sprite palette 0, colour 3
+    }
+
+    SUBCASE("Conversion applies greyscale and emphasis per scanline")
+    {
+        memset(ppu.memory.data() + 0x2000, 1, 960);
+        ppu.writeRegister(0x2001, 0x3F); // Greyscale + red emphasis
+        ppu.renderBackground();
+        CHECK(ppu.framebuffer[0] == (0x13 & 0x30));
+        CHECK(ppu.lineEmphasis[0] == 0x01);
+
+        std::vector<uint32_t> argb(256 * 240);
+        convertFrame(ppu.framebuffer.data(), ppu.lineEmphasis.data(), 256, 240,
+                     PixelFormat::ARGB8888, argb.data(), 256 * sizeof(uint32_t));
+        CHECK(argb[0] == paletteARGB(0x01)[0x10]);
+        CHECK(argb[0] != paletteARGB(0x00)[0x10]);
+
+        std::vector<uint16_t> rgb565(256 * 240);
+        convertFrame(ppu.framebuffer.data(), ppu.lineEmphasis.data(), 256, 240,
+                     PixelFormat::RGB565, rgb565.data(), 256 * sizeof(uint16_t));
+        CHECK(rgb565[0] == paletteRGB565(0x01)[0x10]);
+
+        std::vector<uint8_t> indices(256 * 240);
+        convertFrame(ppu.framebuffer.data(), ppu.lineEmphasis.data(), 256, 240,
+                     PixelFormat::Indexed, indices.data(), 256);
+        CHECK(std::equal(indices.begin(), indices.end(), ppu.framebuffer.begin()));
+    }
+}
+
+// Nametable Mirroring Tests
+TEST_CASE("PPU - Nametable Mirroring")
+{
+    PPU ppu;
+    ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
+
+    auto writeVRAM = [&](uint16_t address, uint8_t value)
+    {
+        setPPUAddress(ppu, address);
+        ppu.writeRegister(0x2007, value);
+    };
+    auto readVRAM = [&](uint16_t address)
+    {
+        setPPUAddress(ppu, address);
+        return ppu.readRegister(0x2007);
+    };
+
+    SUBCASE("Horizontal")
+    {
+        ppu.setMirroring(Mirroring::Horizontal);
+        writeVRAM(0x2005, 0x11);
+        writeVRAM(0x2805, 0x22);
+        CHECK(readVRAM(0x2405) == 0x11);
+        CHECK(readVRAM(0x2C05) == 0x22);
+        CHECK(readVRAM(0x3405) == 0x11); // $3000-$3EFF mirrors $2000-$2EFF
+    }
+
+    SUBCASE("Vertical")
+    {
+        ppu.setMirroring(Mirroring::Vertical);
+        writeVRAM(0x2005, 0x11);
+        writeVRAM(0x2405, 0x22);
+        CHECK(readVRAM(0x2805) == 0x11);
+        CHECK(readVRAM(0x2C05) == 0x22);
+    }
+
+    SUBCASE("Single screen")
+    {
+        ppu.setMirroring(Mirroring::SingleScreenB);
+        writeVRAM(0x2C10, 0x33);
+        CHECK(readVRAM(0x2010) == 0x33);
+        CHECK(readVRAM(0x2410) == 0x33);
+        CHECK(ppu.memory[0x2410] == 0x33); // Second physical page
+
+        ppu.setMirroring(Mirroring::SingleScreenA);
+        CHECK(readVRAM(0x2C10) == 0x00);
+    }
+
+    SUBCASE("Four screen")
+    {
+        ppu.setMirroring(Mirroring::FourScreen);
+        writeVRAM(0x2000, 0x01);
+        writeVRAM(0x2400, 0x02);
+        writeVRAM(0x2800, 0x03);
+        writeVRAM(0x2C00, 0x04);
+        CHECK(readVRAM(0x2000) == 0x01);
+        CHECK(readVRAM(0x2400) == 0x02);
+        CHECK(readVRAM(0x2800) == 0x03);
+        CHECK(readVRAM(0x2C00) == 0x04);
+        CHECK(ppu.resolveNametableAddress(0x2C00) == 0x2C00);
+    }
+
+    SUBCASE("Background fetches follow the selected nametable")
+    {
+        initializePalette(ppu);
+        initializeTileData(ppu, 1, 0xFF);
+        ppu.setMirroring(Mirroring::Horizontal);
+        writeVRAM(0x2800, 0x01);          // First tile of the lower nametable
+        ppu.writeRegister(0x2000, 0x03); // Base nametable $2C00, mirrors $2800
+        ppu.renderBackground();
+        CHECK(ppu.framebuffer[0] == 0x13);
+        CHECK(ppu.framebuffer[8] == 0x0F);
+    }
+}
+
+// Attribute Cache Tests
+TEST_CASE("PPU - Attribute Palettes")
+{
+    PPU ppu;
+    ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF); // Tile 1: colour 3 everywhere
+    memset(ppu.memory.data() + 0x2000, 1, 960);
+
+    auto writeVRAM = [&](uint16_t address, uint8_t value)
+    {
+        setPPUAddress(ppu, address);
+        ppu.writeRegister(0x2007, value);
+    };
+
+    SUBCASE("Each attribute byte covers four 2x2 tile quadrants")
+    {
+        ppu.renderBackground(); // Builds the cache from the zeroed attribute table
+        writeVRAM(0x23C9, 0xE4); // Tiles (4-7, 4-7): palettes 0, 1, 2, 3
+        CHECK(ppu.getTilePalette(0, 4, 4) == 0);
+        CHECK(ppu.getTilePalette(0, 7, 5) == 1);
+        CHECK(ppu.getTilePalette(0, 5, 6) == 2);
+        CHECK(ppu.getTilePalette(0, 7, 7) == 3);
+        CHECK(ppu.getTilePalette(0, 8, 7) == 0);
+
+        ppu.renderBackground();
+        CHECK(ppu.framebuffer[32 * 256 + 32] == 0x13);
+        CHECK(ppu.framebuffer[32 * 256 + 48] == 0x17);
+        CHECK(ppu.framebuffer[48 * 256 + 32] == 0x1B);
+        CHECK(ppu.framebuffer[63 * 256 + 63] == 0x1F);
+        CHECK(ppu.framebuffer[64 * 256 + 64] == 0x13);
+    }
+
+    SUBCASE("The last attribute row covers half a block")
+    {
+        writeVRAM(0x23F8, 0xFF);
+        CHECK(ppu.getTilePalette(0, 0, 28) == 3);
+        CHECK(ppu.getTilePalette(0, 3, 29) == 3);
+    }
+
+    SUBCASE("Writes through a mirror update the physical page")
+    {
+        ppu.setMirroring(Mirroring::Vertical);
+        writeVRAM(0x2FC0, 0x02); // $2C00 mirrors the second page
+        CHECK(ppu.getTilePalette(1, 1, 1) == 2);
+        CHECK(ppu.getTilePalette(1, 2, 0) == 0);
+        writeVRAM(0x2FC0, 0x03);
+        CHECK(ppu.getTilePalette(1, 0, 1) == 3);
+        CHECK(ppu.getTilePalette(0, 0, 0) == 0);
+    }
+
+    SUBCASE("Direct memory writes need an invalidation")
+    {
+        ppu.renderBackground();
+        ppu.memory[0x23C0] = 0x03;
+        ppu.renderBackground();
+        CHECK(ppu.framebuffer[0] == 0x13); // Stale cache
+
+        ppu.invalidateAttributeCache();
+        ppu.renderBackground();
+        CHECK(ppu.framebuffer[0] == 0x1F);
+    }
+}
+
+// Sprite Compositing Tests
+TEST_CASE("PPU - Sprite Priority and Palettes")
+{
+    PPU ppu;
+    ppu.reset();
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF); // Tile 1: colour 3 everywhere
+    memset(ppu.oam.data(), 0xFF, 256);
+
+    SUBCASE("Sprite palettes from attributes")
+    {
+        ppu.oam[0] = 9;
+        ppu.oam[1] = 1;
+        ppu.oam[2] = 0x02; // Palette 2
+        ppu.oam[3] = 16;
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[10 * 256 + 16] == 0x10 + 0x1B); // Entry $3F1B
+    }
+
+    SUBCASE("Behind-background sprites only show through transparent background")
+    {
+        memset(ppu.memory.data() + 0x2000, 1, 1); // Only the first background tile is opaque
+        ppu.oam[0] = 0;
+        ppu.oam[1] = 1;
+        ppu.oam[2] = 0x20; // Behind background
+        ppu.oam[3] = 4;    // Straddles tiles 0 and 1
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[1 * 256 + 5] == 0x13);  // Background wins
+        CHECK(ppu.framebuffer[1 * 256 + 9] == 0x23);  // Sprite over the backdrop
+    }
+
+    SUBCASE("Lower OAM index wins even when it is behind the background")
+    {
+        memset(ppu.memory.data() + 0x2000, 1, 1);
+        ppu.oam[0] = 0;
+        ppu.oam[1] = 1;
+        ppu.oam[2] = 0x20; // Sprite 0: behind background
+        ppu.oam[3] = 0;
+        ppu.oam[4] = 0;
+        ppu.oam[5] = 1;
+        ppu.oam[6] = 0x01; // Sprite 1: in front, palette 1
+        ppu.oam[7] = 0;
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[1 * 256 + 2] == 0x13); // Sprite 0 hides sprite 1 behind the background
+    }
+
+    SUBCASE("8x16 sprites use the tile index bank rule")
+    {
+        for (int row = 0; row < 8; ++row)
+        {
+            ppu.memory[0x1000 + 2 * 16 + row] = 0x80;     // Tile $1002: leftmost pixel, colour 1
+            ppu.memory[0x1000 + 3 * 16 + row + 8] = 0x80; // Tile $1003: leftmost pixel, colour 2
+        }
+        ppu.writeRegister(0x2000, 0x20); // 8x16 sprites
+        ppu.oam[0] = 19;
+        ppu.oam[1] = 0x03; // Odd index: pattern table $1000, tiles 2 and 3
+        ppu.oam[2] = 0x00;
+        ppu.oam[3] = 40;
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+        CHECK(ppu.getSpriteLine(35).count == 1); // Sixteen lines tall
+        CHECK(ppu.framebuffer[20 * 256 + 40] == 0x21); // Top half, colour 1
+        CHECK(ppu.framebuffer[28 * 256 + 40] == 0x22); // Bottom half, colour 2
+
+        ppu.oam[2] = 0xC0; // Flip both ways
+        ppu.invalidateSpriteCache();
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[20 * 256 + 47] == 0x22);
+        CHECK(ppu.framebuffer[28 * 256 + 47] == 0x21);
+    }
+}
+
+// PPUMASK Show and Clip Bits
+TEST_CASE("PPU - Mask Show and Clip Bits")
+{
+    PPU ppu;
+    ppu.reset();
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF); // Tile 1: colour 3 everywhere
+    memset(ppu.memory.data() + 0x2000, 1, 960);
+    memset(ppu.oam.data(), 0xFF, 256);
+    ppu.oam[0] = 99; // Sprite 0 on lines 100-107, x 0-7
+    ppu.oam[1] = 1;
+    ppu.oam[2] = 0x00;
+    ppu.oam[3] = 0;
+    ppu.invalidateSpriteCache();
+
+    SUBCASE("Hidden layers")
+    {
+        ppu.writeRegister(0x2001, 0x14); // Sprites only, left 8 pixels included
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[0] == 0x0F);          // Backdrop
+        CHECK(ppu.framebuffer[100 * 256] == 0x23);
+        CHECK((ppu.PPUSTATUS & 0x40) == 0);         // No hit without the background
+
+        ppu.writeRegister(0x2001, 0x0A); // Background only, left 8 pixels included
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[0] == 0x13);
+        CHECK(ppu.framebuffer[100 * 256] == 0x13);
+    }
+
+    SUBCASE("Left 8 pixels")
+    {
+        ppu.writeRegister(0x2001, 0x18); // Both layers, clipped on the left
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[7] == 0x0F);
+        CHECK(ppu.framebuffer[8] == 0x13);
+        CHECK(ppu.framebuffer[100 * 256 + 7] == 0x0F);
+        CHECK((ppu.PPUSTATUS & 0x40) == 0); // Sprite 0 lies entirely in the clipped column
+
+        ppu.writeRegister(0x2001, 0x1E);
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[7] == 0x13);
+        CHECK(ppu.framebuffer[100 * 256 + 7] == 0x23);
+        CHECK((ppu.PPUSTATUS & 0x40) != 0);
+    }
+}
+
+// Scanline Timing and Deferred Rendering Tests
+TEST_CASE("PPU - Scanline Snapshots")
+{
+    CPU cpu;
+    PPU ppu;
+    ppu.reset();
+    ppu.setCPU(&cpu);
+    cpu.cycles = 0;
+    ppu.writeRegister(0x2001, 0x1E); // Show background and sprites, left 8 pixels included
+
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF);
+    memset(ppu.memory.data() + 0x2000, 1, 960);  // Nametable 0: solid tile 1
+    memset(ppu.memory.data() + 0x2400, 0, 960);  // Nametable 1: blank
+
+    SUBCASE("Mid-frame scroll split")
+    {
+        // Status bar on lines 0-99 from nametable 0, playfield below scrolled into nametable 1
+        cpu.cycles = PPU::scanlineStartCycle(100) - 10;
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2000, 0x01);
+
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        ppu.renderFrame();
+
+        CHECK(ppu.getScanlineState(99).ctrl == 0x00);
+        CHECK(ppu.getScanlineState(100).ctrl == 0x01);
+        CHECK(ppu.framebuffer[99 * 256] == 0x13);
+        CHECK(ppu.framebuffer[100 * 256] == 0x0F);
+    }
+
+    SUBCASE("Fine X scroll shifts the background")
+    {
+        memset(ppu.memory.data() + 0x2000, 0, 960);
+        ppu.memory[0x2001] = 1;          // Only the second tile of the first row is opaque
+        ppu.writeRegister(0x2005, 0x03); // Scroll right by 3 pixels
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.renderFrame();
+        CHECK(ppu.framebuffer[4] == 0x0F);
+        CHECK(ppu.framebuffer[5] == 0x13); // Tile 1 starts at x = 8 - 3
+        CHECK(ppu.framebuffer[12] == 0x13);
+        CHECK(ppu.framebuffer[13] == 0x0F);
+    }
+
+    SUBCASE("Sprite 0 hit becomes visible at its scanline")
+    {
+        memset(ppu.oam.data(), 0xFF, 256);
+        ppu.oam[0] = 99; // Drawn from line 100
+        ppu.oam[1] = 1;
+        ppu.oam[3] = 20;
+        ppu.invalidateSpriteCache();
+        ppu.writeRegister(0x2001, 0x1E);
+
+        cpu.cycles = PPU::scanlineStartCycle(-1) + 1; // Pre-render clears the flags
+        CHECK((ppu.readRegister(0x2002) & 0xC0) == 0x00);
+
+        cpu.cycles = PPU::scanlineStartCycle(99);
+        CHECK((ppu.readRegister(0x2002) & 0x40) == 0x00);
+
+        cpu.cycles = PPU::scanlineStartCycle(101);
+        CHECK((ppu.readRegister(0x2002) & 0x40) != 0x00);
+    }
+
+    SUBCASE("Worker threads draw the same frame as serial rendering")
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            ppu.oam[i * 4] = i * 3;         // Spread over the screen
+            ppu.oam[i * 4 + 1] = 1;
+            ppu.oam[i * 4 + 2] = i & 0x23;  // Mixed palettes and priorities
+            ppu.oam[i * 4 + 3] = i * 4;
+        }
+        for (int i = 0; i < 960; i += 3)
+        {
+            ppu.memory[0x2000 + i] = 0; // Holes in the background
+        }
+        ppu.invalidateSpriteCache();
+        ppu.writeRegister(0x2001, 0x1E);
+        cpu.cycles = PPU::scanlineStartCycle(120);
+        ppu.writeRegister(0x2005, 0x05); // Mid-frame scroll change
+        ppu.writeRegister(0x2005, 0x00);
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+
+        ppu.renderFrame();
+        std::array<uint8_t, 256 * 240> serial = ppu.framebuffer;
+
+        // Same frame again, replayed on four workers
+        cpu.cycles = 0;
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.setRenderThreads(4);
+        cpu.cycles = PPU::scanlineStartCycle(120);
+        ppu.writeRegister(0x2005, 0x05);
+        ppu.writeRegister(0x2005, 0x00);
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+
+        ppu.renderFrame();
+        Frame frame;
+        ppu.copyFrame(frame); // Waits for the workers
+        CHECK(frame.pixels == serial);
+    }
+}
+
+static std::vector<RegisterWrite> registerWrites(const std::vector<RegisterWrite> &entries)
+{
+    std::vector<RegisterWrite> writes;
+    for (const RegisterWrite &entry : entries)
+    {
+        if (entry.access == RegisterAccess::Write)
+            writes.push_back(entry);
+    }
+    return writes;
+}
+
+TEST_CASE("PPU - Register Write Log")
+{
+    CPU cpu;
+    PPU ppu;
+    ppu.reset();
+    ppu.setCPU(&cpu);
+    cpu.cycles = 0;
+    ppu.enableWriteLog(100); // Rounded up to 128 entries
+
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF);
+    memset(ppu.memory.data() + 0x2000, 1, 960);
+    memset(ppu.memory.data() + 0x2400, 0, 960);
+
+    SUBCASE("Writes are stamped with their position in the frame")
+    {
+        uint32_t frame = ppu.getFrameCount();
+        ppu.writeRegister(0x2001, 0x0A);                // During VBlank
+        cpu.cycles = PPU::scanlineStartCycle(100) + 10; // 30 dots into line 100
+        ppu.writeRegister(0x2005, 0x21);
+
+        std::vector<RegisterWrite> writes = registerWrites(ppu.getFrameWrites(frame));
+        REQUIRE(writes.size() == 2);
+        CHECK(writes[0].scanline == 241);
+        CHECK(writes[0].dot == 0);
+        CHECK(writes[0].reg == 1);
+        CHECK(writes[0].value == 0x0A);
+        CHECK(writes[1].cycle == PPU::scanlineStartCycle(100) + 10);
+        CHECK(writes[1].scanline == 100);
+        CHECK(writes[1].dot == ((PPU::scanlineStartCycle(100) + 10) * 3) % 341);
+        CHECK(writes[1].reg == 5);
+
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        ppu.renderFrame();
+        cpu.cycles = 0;
+        ppu.writeRegister(0x2001, 0x00);
+        CHECK(registerWrites(ppu.getFrameWrites(frame)).size() == 2);
+        CHECK(registerWrites(ppu.getFrameWrites(frame + 1)).size() == 1);
+        CHECK(ppu.getFrameWrites(frame + 1).size() == RegisterWrite::FIELD_COUNT + 1);
+    }
+
+    SUBCASE("The ring keeps the most recent writes")
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            ppu.writeRegister(0x2003, static_cast<uint8_t>(i));
+        }
+        std::vector<RegisterWrite> writes = ppu.getFrameWrites(ppu.getFrameCount());
+        REQUIRE(writes.size() == 128);
+        CHECK(writes.front().value == 72);
+        CHECK(writes.back().value == 199);
+    }
+
+    SUBCASE("Replaying a frame reproduces a mid-frame scroll split")
+    {
+        PPU fresh;
+        fresh.reset();
+        fresh.memory = ppu.memory;
+        fresh.oam = ppu.oam;
+
+        uint32_t frame = ppu.getFrameCount();
+        ppu.writeRegister(0x2001, 0x0A);
+        cpu.cycles = PPU::scanlineStartCycle(100) - 10;
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2000, 0x01);
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        ppu.renderFrame();
+
+        fresh.replayFrame(ppu.getFrameWrites(frame));
+        CHECK(fresh.getScanlineState(99).ctrl == 0x00);
+        CHECK(fresh.getScanlineState(100).ctrl == 0x01);
+        CHECK(fresh.framebuffer == ppu.framebuffer);
+        CHECK(fresh.framebuffer[100 * 256] == 0x0F);
+    }
+
+    SUBCASE("Replay restores the start state and repeats stateful reads")
+    {
+        // Leave the previous frame with a scroll, a half-written PPUSCROLL and a VRAM address
+        ppu.writeRegister(0x2001, 0x0A);
+        ppu.writeRegister(0x2000, 0x01);
+        ppu.writeRegister(0x2005, 0x08);
+        ppu.writeRegister(0x2006, 0x20);
+        ppu.writeRegister(0x2006, 0x00);
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        ppu.renderFrame();
+
+        PPU fresh;
+        fresh.reset();
+        fresh.memory = ppu.memory;
+        fresh.oam = ppu.oam;
+
+        uint32_t frame = ppu.getFrameCount();
+        cpu.cycles = PPU::scanlineStartCycle(100) - 10;
+        ppu.readRegister(0x2002); // Resets the half-written PPUSCROLL
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2005, 0x00);
+        ppu.writeRegister(0x2000, 0x00);
+        ppu.readRegister(0x2007);        // Steps the VRAM address to $2001
+        ppu.writeRegister(0x2007, 0x00); // Lands on $2001
+        cpu.cycles = PPU::CPU_CYCLES_PER_FRAME;
+        ppu.renderFrame();
+
+        fresh.replayFrame(ppu.getFrameWrites(frame));
+        CHECK(fresh.getScanlineState(0).ctrl == 0x01);
+        CHECK(fresh.getScanlineState(100).ctrl == 0x00);
+        CHECK(fresh.memory[0x2001] == 0x00);
+        CHECK(fresh.framebuffer == ppu.framebuffer);
+        CHECK(fresh.frameHash() == ppu.frameHash());
+    }
+}
+
+TEST_CASE("PPU - Frame Hashes")
+{
+    CPU cpu;
+    PPU ppu;
+    ppu.reset();
+    ppu.setCPU(&cpu);
+    cpu.cycles = 0;
+
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF);
+    memset(ppu.memory.data() + 0x2000, 1, 960);
+    ppu.writeRegister(0x2001, 0x0A);
+
+    ppu.renderFrame();
+    Frame first;
+    ppu.copyFrame(first);
+    CHECK(first.hash == ppu.frameHash());
+
+    SUBCASE("A static screen hashes the same every frame")
+    {
+        ppu.renderFrame();
+        Frame second;
+        ppu.copyFrame(second);
+        CHECK(second.hash == first.hash);
+        CHECK(second.rowHashes == first.rowHashes);
+    }
+
+    SUBCASE("A changed tile changes its rows and the frame")
+    {
+        ppu.memory[0x2000 + 5 * 32 + 3] = 0; // Row of tiles 5: scanlines 40-47
+        ppu.renderFrame();
+        Frame second;
+        ppu.copyFrame(second);
+        CHECK(second.hash != first.hash);
+        CHECK(second.rowHashes[39] == first.rowHashes[39]);
+        CHECK(second.rowHashes[40] != first.rowHashes[40]);
+        CHECK(second.rowHashes[47] != first.rowHashes[47]);
+        CHECK(second.rowHashes[48] == first.rowHashes[48]);
+    }
+
+    SUBCASE("Emphasis changes the hash")
+    {
+        ppu.writeRegister(0x2001, 0x2A);
+        ppu.renderFrame();
+        CHECK(ppu.frameHash() != first.hash);
+    }
+
+    SUBCASE("Worker threads produce the same hashes")
+    {
+        ppu.setRenderThreads(3);
+        ppu.renderFrame();
+        CHECK(ppu.frameHash() == first.hash);
+    }
+}
+
+TEST_CASE("PPU - Debug Viewers")
+{
+    PPU ppu;
+    ppu.reset();
+    initializePalette(ppu);
+    initializeTileData(ppu, 1, 0xFF); // Tile 1: colour 3 everywhere
+    const uint32_t *colors = paletteARGB(0);
+
+    SUBCASE("Pattern tables with a selected palette")
+    {
+        std::vector<uint32_t> image(PPU::PATTERN_VIEW_WIDTH * PPU::PATTERN_VIEW_HEIGHT);
+        ppu.viewPatternTables(image.data(), PPU::PATTERN_VIEW_WIDTH * 4, 1);
+        CHECK(image[0] == colors[0x0F]);  // Tile 0 is blank: backdrop
+        CHECK(image[8] == colors[0x17]);  // Tile 1, palette 1 entry 3
+        CHECK(image[128] == colors[0x0F]); // Second table is empty
+    }
+
+    SUBCASE("Nametables through the mirroring, with the scroll window")
+    {
+        ppu.setMirroring(Mirroring::Horizontal);
+        ppu.memory[0x2000] = 1;            // Top-left tile of the first page
+        ppu.memory[0x23C0] = 0x01;         // Its attribute: palette 1
+        std::vector<uint32_t> image(PPU::NAMETABLE_VIEW_WIDTH * PPU::NAMETABLE_VIEW_HEIGHT);
+        ppu.viewNametables(image.data(), PPU::NAMETABLE_VIEW_WIDTH * 4, false);
+        CHECK(image[1 * 512 + 1] == colors[0x17]);
+        CHECK(image[1 * 512 + 257] == colors[0x17]);       // $2400 mirrors $2000
+        CHECK(image[241 * 512 + 1] == colors[0x0F]);       // $2800 is the other page
+
+        ppu.viewNametables(image.data(), PPU::NAMETABLE_VIEW_WIDTH * 4, true);
+        CHECK(image[100] == (colors[0x0F] ^ 0x00FFFFFF));   // Top edge of the window at scroll (0, 0)
+        CHECK(image[1 * 512 + 1] == colors[0x17]);         // Inside the window is untouched
+        CHECK(image[239 * 512 + 10] == (colors[0x0F] ^ 0x00FFFFFF));
+    }
+
+    SUBCASE("Sprites in OAM order")
+    {
+        ppu.oam[4 * 3 + 1] = 1;    // Sprite 3 uses tile 1
+        ppu.oam[4 * 3 + 2] = 0x02; // Sprite palette 2
+        std::vector<uint32_t> image(PPU::SPRITE_VIEW_WIDTH * PPU::SPRITE_VIEW_HEIGHT);
+        ppu.viewSprites(image.data(), PPU::SPRITE_VIEW_WIDTH * 4);
+        CHECK(image[3 * 8] == colors[0x2B]);        // Entry $1B
+        CHECK(image[10 * 64 + 3 * 8] == colors[0x0F]); // 8x8 sprites leave the lower half empty
+        CHECK(image[0] == colors[0x0F]);
+    }
+
+    SUBCASE("Palette RAM")
+    {
+        std::vector<uint32_t> image(PPU::PALETTE_VIEW_WIDTH * PPU::PALETTE_VIEW_HEIGHT);
+        ppu.viewPalettes(image.data(), PPU::PALETTE_VIEW_WIDTH * 4);
+        CHECK(image[5 * 16] == colors[0x15]);
+        CHECK(image[16 * 256 + 2 * 16] == colors[0x22]); // Sprite entry 2
+    }
+}
@@ -0,0 +1,85 @@
+#include "resampler.h"
+#include "doctest.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+TEST_CASE("Resampler - Ratios")
+{
+    Resampler resampler;
+    std::vector<int16_t> in(10000, 10000);
+    std::vector<int16_t> out(11000);
+
+    SUBCASE("Unity ratio passes samples through, delayed")
+    {
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            in[i] = static_cast<int16_t>(std::lround(8000.0 * std::sin(i * 0.1)));
+        }
+        size_t count = resampler.process(in.data(), in.size(), out.data(), out.size());
+        CHECK(count == in.size());
+
+        const int delay = Resampler::TAPS / 2;
+        int worst = 0;
+        for (size_t i = Resampler::TAPS; i < count; ++i)
+        {
+            worst = std::max(worst, std::abs(out[i] - in[i - delay]));
+        }
+        CHECK(worst <= 40);
+    }
+
+    SUBCASE("Stretching and squeezing change the sample count")
+    {
+        resampler.setRatio(1.005);
+        CHECK(std::abs(static_cast<int>(resampler.process(in.data(), in.size(), out.data(), out.size())) - 10050) <= Resampler::TAPS);
+
+        resampler.reset();
+        resampler.setRatio(0.995);
+        CHECK(std::abs(static_cast<int>(resampler.process(in.data(), in.size(), out.data(), out.size())) - 9950) <= Resampler::TAPS);
+    }
+
+    SUBCASE("A constant input stays constant at any phase")
+    {
+        resampler.setRatio(1.0037);
+        size_t count = resampler.process(in.data(), in.size(), out.data(), out.size());
+        bool flat = true;
+        for (size_t i = Resampler::TAPS; i < count; ++i)
+        {
+            flat = flat && std::abs(out[i] - 10000) <= 1;
+        }
+        CHECK(flat);
+    }
+
+    SUBCASE("Input that does not fit is kept for the next call")
+    {
+        size_t first = resampler.process(in.data(), 1000, out.data(), 500);
+        CHECK(first == 500);
+        size_t second = resampler.process(in.data(), 0, out.data(), out.size());
+        CHECK(first + second == 1000);
+    }
+}
+
+TEST_CASE("Resampler - Rate Control")
+{
+    RateControl control(1764.0); // 40ms at 44.1kHz
+
+    CHECK(control.update(1764) == doctest::Approx(1.0));
+
+    // Too shallow: stretch, at most 0.5%
+    double ratio = 1.0;
+    for (int i = 0; i < 200; ++i)
+    {
+        ratio = control.update(0);
+    }
+    CHECK(ratio == doctest::Approx(1.005));
+
+    // Too deep: squeeze, approaching the new depth gradually
+    double first = control.update(5000);
+    CHECK(first > 0.995);
+    for (int i = 0; i < 200; ++i)
+    {
+        ratio = control.update(5000);
+    }
+    CHECK(ratio == doctest::Approx(0.995));
+    CHECK(ratio < first);
+}
@@ -0,0 +1,112 @@
+#include "scaler.h"
+#include "worker_pool.h"
+#include "doctest.h"
+#include <vector>
+
+TEST_CASE("Scaler - Nearest")
+{
+    const uint8_t src[4] = {1, 2,
+                            3, 4};
+    std::vector<uint8_t> dst(6 * 6);
+    scaleNearest(src, 2, 2, 2, 3, dst.data(), 6);
+
+    CHECK(dst[0] == 1);
+    CHECK(dst[2] == 1);
+    CHECK(dst[3] == 2);
+    CHECK(dst[2 * 6 + 5] == 2);
+    CHECK(dst[3 * 6] == 3);
+    CHECK(dst[5 * 6 + 5] == 4);
+}
+
+TEST_CASE("Scaler - Scale2x and Scale3x")
+{
+    // A diagonal edge: the top-left corner of the centre pixel is rounded off
+    const uint8_t src[9] = {0, 1, 0,
+                            1, 0, 0,
+                            0, 0, 0};
+
+    SUBCASE("Scale2x")
+    {
+        std::vector<uint8_t> dst(6 * 6);
+        scale2x(src, 3, 3, 3, dst.data(), 6);
+        CHECK(dst[2 * 6 + 2] == 1); // Centre pixel, top-left quarter takes the edge colour
+        CHECK(dst[2 * 6 + 3] == 0);
+        CHECK(dst[3 * 6 + 2] == 0);
+        CHECK(dst[3 * 6 + 3] == 0);
+    }
+
+    SUBCASE("Scale3x")
+    {
+        std::vector<uint8_t> dst(9 * 9);
+        scale3x(src, 3, 3, 3, dst.data(), 9);
+        CHECK(dst[3 * 9 + 3] == 1);
+        CHECK(dst[3 * 9 + 4] == 0); // No bleeding along the edge: E == C
+        CHECK(dst[4 * 9 + 4] == 0); // Centre is always E
+        CHECK(dst[5 * 9 + 5] == 0);
+    }
+
+    SUBCASE("Flat areas are unchanged")
+    {
+        const uint16_t flat[4] = {7, 7, 7, 7};
+        std::vector<uint16_t> dst(6 * 6);
+        scale3x(flat, 4, 2, 2, dst.data(), 12);
+        for (uint16_t pixel : dst)
+        {
+            CHECK(pixel == 7);
+        }
+    }
+}
+
+TEST_CASE("Scaler - HQ2x")
+{
+    SUBCASE("Flat areas are unchanged")
+    {
+        std::vector<uint32_t> src(4 * 4, 0xFF336699);
+        std::vector<uint32_t> dst(8 * 8);
+        hq2x(src.data(), 16, 4, 4, dst.data(), 32);
+        for (uint32_t pixel : dst)
+        {
+            CHECK(pixel == 0xFF336699);
+        }
+    }
+
+    SUBCASE("Edges are blended")
+    {
+        // Left half black, right half white
+        std::vector<uint32_t> src(4 * 4);
+        for (int i = 0; i < 16; ++i)
+        {
+            src[i] = (i % 4) < 2 ? 0xFF000000 : 0xFFFFFFFF;
+        }
+        std::vector<uint32_t> dst(8 * 8);
+        hq2x(src.data(), 16, 4, 4, dst.data(), 32);
+        CHECK(dst[0] == 0xFF000000);       // Away from the edge
+        CHECK(dst[3] == 0xFF3F3F3F);       // Black pixel next to white: 6/8 black, 2/8 white
+        CHECK(dst[4] == 0xFFBFBFBF);
+        CHECK((dst[3] >> 24) == 0xFF);     // Alpha is kept
+    }
+}
+
+TEST_CASE("Scaler - Worker Bands")
+{
+    // Pseudo-random frame with many edges
+    std::vector<uint32_t> src(256 * 240);
+    uint32_t seed = 12345;
+    for (uint32_t &pixel : src)
+    {
+        seed = seed * 1103515245 + 12345;
+        pixel = 0xFF000000 | ((seed >> 16) & 0x3) * 0x404040;
+    }
+
+    WorkerPool pool(3);
+    const ScaleFilter filters[] = {ScaleFilter::Nearest, ScaleFilter::Scale2x, ScaleFilter::Scale3x, ScaleFilter::HQ2x};
+    for (ScaleFilter filter : filters)
+    {
+        int factor = scaleFactor(filter, 4);
+        std::vector<uint32_t> serial(256 * factor * 240 * factor);
+        std::vector<uint32_t> banded(serial.size());
+        scaleFrame(filter, src.data(), 256 * 4, 256, 240, 4, serial.data(), 256 * factor * 4);
+        scaleFrame(filter, src.data(), 256 * 4, 256, 240, 4, banded.data(), 256 * factor * 4, &pool);
+        CHECK(serial == banded);
+    }
+}
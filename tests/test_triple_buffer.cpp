@@ -0,0 +1,65 @@
+#include "triple_buffer.h"
+#include "doctest.h"
+#include <thread>
+
+TEST_CASE("TripleBuffer - Frame Handoff")
+{
+    TripleBuffer<int> buffer;
+
+    SUBCASE("Nothing to read before the first publish")
+    {
+        CHECK(buffer.update() == false);
+    }
+
+    SUBCASE("Consumer sees the newest frame and drops older ones")
+    {
+        buffer.writeBuffer() = 1;
+        buffer.publish();
+        buffer.writeBuffer() = 2;
+        buffer.publish();
+
+        CHECK(buffer.update() == true);
+        CHECK(buffer.readBuffer() == 2);
+        CHECK(buffer.update() == false); // No new frame since
+        CHECK(buffer.readBuffer() == 2); // Front buffer stays valid
+    }
+
+    SUBCASE("Producer never writes into the buffer being read")
+    {
+        buffer.writeBuffer() = 1;
+        buffer.publish();
+        buffer.update();
+
+        buffer.writeBuffer() = 3;
+        buffer.publish();
+        buffer.writeBuffer() = 4;
+        CHECK(buffer.readBuffer() == 1);
+    }
+
+    SUBCASE("Frames arrive in order across threads")
+    {
+        std::thread producer([&]()
+        {
+            for (int frame = 1; frame <= 10000; ++frame)
+            {
+                buffer.writeBuffer() = frame;
+                buffer.publish();
+            }
+        });
+
+        int last = 0;
+        bool ordered = true;
+        while (last < 10000)
+        {
+            if (buffer.update())
+            {
+                ordered = ordered && buffer.readBuffer() > last;
+                last = buffer.readBuffer();
+            }
+        }
+        producer.join();
+
+        CHECK(ordered);
+        CHECK(last == 10000);
+    }
+}
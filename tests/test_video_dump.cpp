@@ -0,0 +1,144 @@
+#include "video_dump.h"
+#include "ppu.h"
+#include "doctest.h"
+#include "test_helpers.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void fillFrame(Frame &frame, uint8_t index)
+    {
+        frame.pixels.fill(index);
+        frame.emphasis.fill(0);
+    }
+}
+
+TEST_CASE("AsyncFileWriter - Ordered Writes From a Bounded Pool")
+{
+    const std::string path = "test_async_writer.bin";
+    AsyncFileWriter writer(2, 16);
+    REQUIRE(writer.open(path));
+
+    for (int i = 0; i < 50; ++i)
+    {
+        AsyncFileWriter::Buffer &buffer = writer.acquire();
+        buffer.data[0] = static_cast<uint8_t>(i);
+        buffer.size = 1;
+        writer.submit(buffer);
+    }
+    writer.close();
+    CHECK_FALSE(writer.failed());
+
+    std::vector<uint8_t> data = readFile(path);
+    REQUIRE(data.size() == 50);
+    for (int i = 0; i < 50; ++i)
+    {
+        CHECK(data[i] == i);
+    }
+    remove(path.c_str());
+}
+
+TEST_CASE("VideoDump - Formats")
+{
+    Frame frame;
+
+    SUBCASE("Format from the file name")
+    {
+        CHECK(VideoDump::formatForPath("out.y4m") == VideoFormat::Y4M);
+        CHECK(VideoDump::formatForPath("out.rgb") == VideoFormat::RawRGB);
+        CHECK(VideoDump::formatForPath("frames/shot.png") == VideoFormat::PNG);
+        CHECK(VideoDump::formatForPath("-") == VideoFormat::Y4M);
+    }
+
+    SUBCASE("Y4M stream")
+    {
+        const std::string path = "test_dump.y4m";
+        VideoDump dump;
+        REQUIRE(dump.open(path, VideoFormat::Y4M));
+        fillFrame(frame, 0x30); // White
+        dump.writeFrame(frame);
+        fillFrame(frame, 0x0F); // Black
+        dump.writeFrame(frame);
+        dump.close();
+
+        std::vector<uint8_t> data = readFile(path);
+        std::string header = "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7 C420jpeg\n";
+        const size_t frameSize = 6 + 256 * 240 * 3 / 2;
+        REQUIRE(data.size() == header.size() + 2 * frameSize);
+        CHECK(std::string(data.begin(), data.begin() + header.size()) == header);
+
+        const uint8_t *first = data.data() + header.size();
+        CHECK(memcmp(first, "FRAME\n", 6) == 0);
+        CHECK(first[6] == 235);                   // White luma
+        CHECK(first[6 + 256 * 240] == 128);       // Neutral chroma
+        CHECK(first[frameSize + 6] == 16);        // Black luma in the second frame
+        remove(path.c_str());
+    }
+
+    SUBCASE("Raw RGB frames")
+    {
+        const std::string path = "test_dump.rgb";
+        VideoDump dump;
+        REQUIRE(dump.open(path, VideoFormat::RawRGB));
+        fillFrame(frame, 0x30);
+        frame.pixels[1] = 0x0F;
+        dump.writeFrame(frame);
+        dump.close();
+
+        std::vector<uint8_t> data = readFile(path);
+        REQUIRE(data.size() == 256 * 240 * 3);
+        CHECK(data[0] == 0xFF);
+        CHECK(data[3] == 0x00);
+        remove(path.c_str());
+    }
+
+    SUBCASE("Numbered PNG files")
+    {
+        VideoDump dump;
+        REQUIRE(dump.open("test_dump.png", VideoFormat::PNG));
+        fillFrame(frame, 0x16);
+        dump.writeFrame(frame);
+        dump.writeFrame(frame);
+        dump.close();
+        CHECK(dump.framesWritten() == 2);
+
+        std::vector<uint8_t> data = readFile("test_dump_000001.png");
+        const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        REQUIRE(data.size() > 100);
+        CHECK(memcmp(data.data(), signature, 8) == 0);
+        CHECK(memcmp(data.data() + 12, "IHDR", 4) == 0);
+        CHECK(memcmp(data.data() + data.size() - 8, "IEND", 4) == 0);
+
+        // First stored block starts with the filter byte and the first pixel (0x16 = B53120)
+        const uint8_t *idat = data.data() + 8 + 25 + 8;
+        CHECK(idat[0] == 0x78);
+        CHECK(idat[2] == 0x00); // Not the final block
+        CHECK(idat[7] == 0x00); // Filter: none
+        CHECK(idat[8] == 0xB5);
+        CHECK(idat[9] == 0x31);
+        CHECK(idat[10] == 0x20);
+
+        remove("test_dump_000000.png");
+        remove("test_dump_000001.png");
+    }
+}
+
+TEST_CASE("VideoDump - Write Errors Are Reported")
+{
+    // /dev/full accepts the open and fails every write, like a full disk
+    FILE *full = fopen("/dev/full", "wb");
+    if (!full)
+        return;
+    fclose(full);
+
+    VideoDump dump;
+    REQUIRE(dump.open("/dev/full", VideoFormat::RawRGB));
+    Frame frame = {};
+    fillFrame(frame, 0x0F);
+    dump.writeFrame(frame);
+    dump.close();
+    CHECK(dump.failed());
+}